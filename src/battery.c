@@ -0,0 +1,145 @@
+#include "battery.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bus.h"
+
+#define BATTERY_SIZE sizeof(((cartridge *)0)->prg_ram)
+
+// Every mapping of the process, made private in fork()ed children
+static struct {
+  pthread_mutex_t lock;
+  uint8_t **rams;
+  size_t count, capacity;
+} mappings = {.lock = PTHREAD_MUTEX_INITIALIZER};
+static pthread_once_t atfork_once = PTHREAD_ONCE_INIT;
+
+static void lock_mappings(void) { pthread_mutex_lock(&mappings.lock); }
+
+static void unlock_mappings(void) { pthread_mutex_unlock(&mappings.lock); }
+
+// Replace each shared mapping by a private copy at the same address, so the
+// child's writes stay in the child and its pointers stay valid
+static void privatize_mappings(void) {
+  for (size_t i = 0; i < mappings.count; i++) {
+    uint8_t *ram = mappings.rams[i];
+    uint8_t copy[BATTERY_SIZE];
+    memcpy(copy, ram, BATTERY_SIZE);
+    if (mmap(ram, BATTERY_SIZE, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED) {
+      _exit(127); // the child would write into the parent's save
+    }
+    memcpy(ram, copy, BATTERY_SIZE);
+  }
+  unlock_mappings();
+}
+
+static void install_atfork(void) {
+  pthread_atfork(lock_mappings, unlock_mappings, privatize_mappings);
+}
+
+static bool add_mapping(uint8_t *ram) {
+  lock_mappings();
+  bool ok = true;
+  if (mappings.count == mappings.capacity) {
+    size_t capacity = mappings.capacity ? mappings.capacity * 2 : 4;
+    uint8_t **rams = realloc(mappings.rams, capacity * sizeof(uint8_t *));
+    if (rams) {
+      mappings.rams = rams;
+      mappings.capacity = capacity;
+    } else {
+      ok = false;
+    }
+  }
+  if (ok) {
+    mappings.rams[mappings.count++] = ram;
+  }
+  unlock_mappings();
+  return ok;
+}
+
+static void remove_mapping(uint8_t *ram) {
+  lock_mappings();
+  for (size_t i = 0; i < mappings.count; i++) {
+    if (mappings.rams[i] == ram) {
+      mappings.rams[i] = mappings.rams[--mappings.count];
+      break;
+    }
+  }
+  unlock_mappings();
+}
+
+bool battery_attach(nes *n, const char *path) {
+  if (n->cartridge.battery_ram) {
+    errno = EBUSY;
+    return false;
+  }
+  if (!n->cartridge.battery) {
+    errno = ENOTSUP;
+    return false;
+  }
+  pthread_once(&atfork_once, install_atfork);
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return false;
+  }
+  bool created = st.st_size == 0;
+  if ((size_t)st.st_size < BATTERY_SIZE && ftruncate(fd, BATTERY_SIZE) != 0) {
+    close(fd);
+    return false;
+  }
+  uint8_t *ram =
+      mmap(NULL, BATTERY_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  int error = errno;
+  close(fd);
+  if (ram == MAP_FAILED) {
+    errno = error;
+    return false;
+  }
+  if (!add_mapping(ram)) {
+    munmap(ram, BATTERY_SIZE);
+    errno = ENOMEM;
+    return false;
+  }
+
+  if (created) {
+    memcpy(ram, n->cartridge.prg_ram, BATTERY_SIZE);
+  }
+  n->cartridge.battery_ram = ram;
+  bus_map_pages(n);
+  return true;
+}
+
+bool battery_sync(nes *n, bool wait) {
+  if (!n->cartridge.battery_ram) {
+    return true;
+  }
+  return msync(n->cartridge.battery_ram, BATTERY_SIZE,
+               wait ? MS_SYNC : MS_ASYNC) == 0;
+}
+
+bool battery_detach(nes *n) {
+  uint8_t *ram = n->cartridge.battery_ram;
+  if (!ram) {
+    return true;
+  }
+  bool ok = msync(ram, BATTERY_SIZE, MS_SYNC) == 0;
+  memcpy(n->cartridge.prg_ram, ram, BATTERY_SIZE);
+  remove_mapping(ram);
+  munmap(ram, BATTERY_SIZE);
+  n->cartridge.battery_ram = NULL;
+  bus_map_pages(n);
+  return ok;
+}
@@ -0,0 +1,31 @@
+#ifndef BATTERY_H
+#define BATTERY_H
+
+#include <stdbool.h>
+
+#include "nes.h"
+
+// Battery-backed PRG RAM ($6000-$7FFF) kept in a save file through a shared
+// memory mapping. The mapping replaces cartridge.prg_ram as the direct page
+// behind $6000, so saving costs the same as a RAM write and nothing is ever
+// copied out: the page cache holds every write as it happens, and survives the
+// process crashing. battery_sync() forces it to disk.
+//
+// nes_save_state() copies the mapped contents into the state, and
+// nes_load_state() copies them back into the mapping, so loading a state
+// rewrites the save like it would on hardware. In processes fork()ed from n
+// the mapping becomes a private copy, so their writes never reach the file.
+
+// Map the save file at path, created with the current PRG RAM contents if it
+// does not exist, as PRG RAM of n, after nes_load_rom(). Returns false and sets
+// errno on failure, ENOTSUP if the cartridge has no battery.
+bool battery_attach(nes *n, const char *path);
+
+// Schedule dirty pages of the save for writeback, or wait for it
+bool battery_sync(nes *n, bool wait);
+
+// Write the save back, unmap it and copy its contents into
+// cartridge.prg_ram. Returns false if the writeback failed.
+bool battery_detach(nes *n);
+
+#endif // BATTERY_H
@@ -0,0 +1,174 @@
+#include "bus.h"
+
+#include "cdl.h"
+#include "cpu_step.h"
+#include "debugger.h"
+#include "heatmap.h"
+#include "ppu_step.h"
+#include "render_thread.h"
+
+static uint8_t open_bus_read(nes *n, uint16_t addr) {
+  (void)n;
+  (void)addr;
+  return 0;
+}
+
+static void open_bus_write(nes *n, uint16_t addr, uint8_t val) {
+  (void)n;
+  (void)addr;
+  (void)val;
+}
+
+// upper bits are open bus, usually the high byte of the address
+static uint8_t joy1_read(nes *n, uint16_t addr) {
+  (void)addr;
+  return controller_read(&n->controllers[0]) | 0x40;
+}
+
+static uint8_t joy2_read(nes *n, uint16_t addr) {
+  (void)addr;
+  return controller_read(&n->controllers[1]) | 0x40;
+}
+
+static uint8_t joy1_peek(const nes *n, uint16_t addr) {
+  (void)addr;
+  return controller_peek(&n->controllers[0]) | 0x40;
+}
+
+static uint8_t joy2_peek(const nes *n, uint16_t addr) {
+  (void)addr;
+  return controller_peek(&n->controllers[1]) | 0x40;
+}
+
+static void joy_strobe(nes *n, uint16_t addr, uint8_t val) {
+  (void)addr;
+  controller_write(&n->controllers[0], val);
+  controller_write(&n->controllers[1], val);
+}
+
+// https://www.nesdev.org/wiki/PPU_registers#OAMDMA
+static void oam_dma(nes *n, uint16_t addr, uint8_t val) {
+  (void)addr;
+  uint16_t page = val << 8;
+  for (int i = 0; i < 256; i++) {
+    uint8_t oam_addr = n->ppu.oam_addr + i;
+    n->ppu.oam[oam_addr] = cpu_dma_read(n, page | i);
+    if (n->render_thread) {
+      render_thread_record(n, RENDER_EVENT_OAM, oam_addr, n->ppu.oam[oam_addr]);
+    }
+  }
+  n->cpu_stall += 513 + (n->cpu.cycles & 1);
+}
+
+static uint8_t cartridge_read(nes *n, uint16_t addr) {
+  return cartridge_read_prg(&n->cartridge, addr);
+}
+
+static void cartridge_write(nes *n, uint16_t addr, uint8_t val) {
+  cartridge_write_prg(&n->cartridge, addr, val);
+}
+
+#define OPEN_BUS {open_bus_read, open_bus_write, NULL}
+
+static const io_register registers[BUS_IO_REGISTERS] = {
+    // $2000-$2007
+    {ppu_read_open_bus, ppu_write_ctrl, NULL},
+    {ppu_read_open_bus, ppu_write_mask, NULL},
+    {ppu_read_status, ppu_write_open_bus, ppu_peek_status},
+    {ppu_read_open_bus, ppu_write_oam_addr, NULL},
+    {ppu_read_oam_data, ppu_write_oam_data, NULL},
+    {ppu_read_open_bus, ppu_write_scroll, NULL},
+    {ppu_read_open_bus, ppu_write_addr, NULL},
+    {ppu_read_data, ppu_write_data, ppu_peek_data},
+    // $4000-$4013 APU, $4014 OAMDMA, $4015 APU status
+    OPEN_BUS, OPEN_BUS, OPEN_BUS, OPEN_BUS, OPEN_BUS, OPEN_BUS, OPEN_BUS,
+    OPEN_BUS, OPEN_BUS, OPEN_BUS, OPEN_BUS, OPEN_BUS, OPEN_BUS, OPEN_BUS,
+    OPEN_BUS, OPEN_BUS, OPEN_BUS, OPEN_BUS, OPEN_BUS, OPEN_BUS,
+    {open_bus_read, oam_dma, NULL},
+    OPEN_BUS,
+    // $4016 controllers, $4017 also APU frame counter on write
+    {joy1_read, joy_strobe, joy1_peek},
+    {joy2_read, open_bus_write, joy2_peek},
+    // $4018-$401F test mode
+    OPEN_BUS, OPEN_BUS, OPEN_BUS, OPEN_BUS, OPEN_BUS, OPEN_BUS, OPEN_BUS,
+    OPEN_BUS,
+    // cartridge windows of NROM: $4020-$5FFF is unused, $6000-$7FFF PRG RAM,
+    // and $8000-$FFFF PRG ROM without mapper registers behind it
+    OPEN_BUS,
+    {cartridge_read, cartridge_write, NULL},
+    {cartridge_read, open_bus_write, NULL},
+};
+
+static const io_register *io_register_at(uint16_t addr) {
+  if (addr < 0x4000) {
+    return &registers[addr & 7];
+  }
+  if (addr < 0x4020) {
+    return &registers[8 + (addr & 0x1F)];
+  }
+  if (addr < 0x6000) {
+    return &registers[BUS_IO_REGISTERS - 3];
+  }
+  if (addr < 0x8000) {
+    return &registers[BUS_IO_REGISTERS - 2];
+  }
+  return &registers[BUS_IO_REGISTERS - 1];
+}
+
+uint8_t bus_read(nes *n, uint16_t addr) {
+  if (addr < 0x2000) {
+    return n->ram[addr & 0x07FF];
+  }
+  const io_register *r = io_register_at(addr);
+  // the render thread replays PPU reads with side effects
+  if (addr < 0x4000 && r->peek && n->render_thread) {
+    render_thread_record(n, RENDER_EVENT_READ, addr, 0);
+  }
+  return r->read(n, addr);
+}
+
+void bus_write(nes *n, uint16_t addr, uint8_t val) {
+  if (addr < 0x2000) {
+    n->ram[addr & 0x07FF] = val;
+  } else {
+    if (addr < 0x4000 && n->render_thread) {
+      render_thread_record(n, RENDER_EVENT_WRITE, addr, val);
+    }
+    io_register_at(addr)->write(n, addr, val);
+  }
+}
+
+uint8_t bus_peek(const nes *n, uint16_t addr) {
+  if (addr < 0x2000) {
+    return n->ram[addr & 0x07FF];
+  }
+  const io_register *r = io_register_at(addr);
+  // a read without side effects leaves n unchanged
+  return r->peek ? r->peek(n, addr) : r->read((nes *)n, addr);
+}
+
+void bus_map_pages(nes *n) {
+  for (int i = 0; i < NES_PAGES; i++) {
+    uint16_t addr = i << NES_PAGE_BITS;
+    if (addr < 0x2000) {
+      // the page size is the RAM size, so mirrors map to the same page
+      n->read_pages[i] = n->ram;
+      n->write_pages[i] = n->ram;
+    } else if (0x4020 <= addr) {
+      n->read_pages[i] = cartridge_prg_read_page(&n->cartridge, addr);
+      n->write_pages[i] = cartridge_prg_write_page(&n->cartridge, addr);
+    } else {
+      n->read_pages[i] = NULL;
+      n->write_pages[i] = NULL;
+    }
+  }
+  if (n->debugger) {
+    debugger_protect_pages(n);
+  }
+  if (n->cdl) {
+    cdl_protect_pages(n);
+  }
+  if (n->heatmap) {
+    heatmap_protect_pages(n);
+  }
+}
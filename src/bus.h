@@ -0,0 +1,32 @@
+#ifndef BUS_H
+#define BUS_H
+
+#include <stdint.h>
+
+#include "nes.h"
+
+// CPU memory map of the console
+// https://www.nesdev.org/wiki/CPU_memory_map
+uint8_t bus_read(nes *n, uint16_t addr);
+
+void bus_write(nes *n, uint16_t addr, uint8_t val);
+
+// bus_read() without side effects, for debuggers and tools
+uint8_t bus_peek(const nes *n, uint16_t addr);
+
+// Handlers of one I/O register, or of a window of cartridge space
+typedef struct IORegister {
+  uint8_t (*read)(nes *n, uint16_t addr);
+  void (*write)(nes *n, uint16_t addr, uint8_t val);
+  // Side-effect-free read; NULL if read itself has no side effects
+  uint8_t (*peek)(const nes *n, uint16_t addr);
+} io_register;
+
+// $2000-$2007 with their mirrors up to $3FFF collapsed, $4000-$401F and
+// the cartridge windows $4020-$5FFF, $6000-$7FFF and $8000-$FFFF
+#define BUS_IO_REGISTERS (8 + 0x20 + 3)
+
+// Point the pages of n to RAM and cartridge memory mapped by the bus
+void bus_map_pages(nes *n);
+
+#endif // BUS_H
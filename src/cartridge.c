@@ -0,0 +1,104 @@
+#include "cartridge.h"
+
+#include <string.h>
+
+#include "hash.h"
+
+bool cartridge_load(cartridge *c, const uint8_t *rom, size_t size) {
+  // https://www.nesdev.org/wiki/INES
+  if (size < 16 || memcmp(rom, "NES\x1A", 4) != 0) {
+    return false;
+  }
+  uint8_t flags6 = rom[6];
+  uint8_t flags7 = rom[7];
+  size_t prg_size = (size_t)rom[4] * 0x4000;
+  size_t chr_size = (size_t)rom[5] * 0x2000;
+  size_t offset = 16 + ((flags6 & 0x04) ? 512 : 0); // trainer
+
+  if (prg_size == 0 || size < offset + prg_size + chr_size) {
+    return false;
+  }
+
+  uint8_t mapper = (flags7 & 0xF0) | (flags6 >> 4);
+  switch (mapper) {
+  case 0: // NROM
+    if (prg_size != 0x4000 && prg_size != 0x8000) {
+      return false;
+    }
+    break;
+  default:
+    return false;
+  }
+
+  c->prg_rom = rom + offset;
+  c->prg_rom_size = prg_size;
+  c->chr_rom = chr_size ? rom + offset + prg_size : NULL;
+  c->chr_rom_size = chr_size;
+  c->mapper = mapper;
+  c->mirroring = (flags6 & 0x01) ? MIRRORING_VERTICAL : MIRRORING_HORIZONTAL;
+  c->battery = (flags6 & 0x02) != 0;
+  memset(c->prg_ram, 0, sizeof(c->prg_ram));
+  memset(c->chr_ram, 0, sizeof(c->chr_ram));
+  return true;
+}
+
+uint64_t cartridge_hash(const cartridge *c) {
+  uint64_t h = hash64(c->prg_rom, c->prg_rom_size, 0);
+  return hash64(c->chr_rom, c->chr_rom_size, h);
+}
+
+static uint8_t *prg_ram(cartridge *c) {
+  return c->battery_ram ? c->battery_ram : c->prg_ram;
+}
+
+const uint8_t *cartridge_prg_ram(const cartridge *c) {
+  return c->battery_ram ? c->battery_ram : c->prg_ram;
+}
+
+uint8_t cartridge_read_prg(cartridge *c, uint16_t addr) {
+  if (0x8000 <= addr) {
+    // NROM-128 mirrors its 16KB at $C000
+    return c->prg_rom[(addr - 0x8000) & (c->prg_rom_size - 1)];
+  }
+  if (0x6000 <= addr) {
+    return prg_ram(c)[addr - 0x6000];
+  }
+  return 0;
+}
+
+void cartridge_write_prg(cartridge *c, uint16_t addr, uint8_t val) {
+  if (0x6000 <= addr && addr < 0x8000) {
+    prg_ram(c)[addr - 0x6000] = val;
+  }
+}
+
+const uint8_t *cartridge_prg_read_page(const cartridge *c, uint16_t addr) {
+  if (0x8000 <= addr) {
+    return c->prg_rom ? &c->prg_rom[(addr - 0x8000) & (c->prg_rom_size - 1)]
+                      : NULL;
+  }
+  if (0x6000 <= addr) {
+    return &cartridge_prg_ram(c)[addr - 0x6000];
+  }
+  return NULL;
+}
+
+uint8_t *cartridge_prg_write_page(cartridge *c, uint16_t addr) {
+  if (0x6000 <= addr && addr < 0x8000) {
+    return &prg_ram(c)[addr - 0x6000];
+  }
+  return NULL;
+}
+
+uint8_t cartridge_read_chr(cartridge *c, uint16_t addr) {
+  if (c->chr_rom_size) {
+    return c->chr_rom[addr & 0x1FFF];
+  }
+  return c->chr_ram[addr & 0x1FFF];
+}
+
+void cartridge_write_chr(cartridge *c, uint16_t addr, uint8_t val) {
+  if (!c->chr_rom_size) {
+    c->chr_ram[addr & 0x1FFF] = val;
+  }
+}
@@ -0,0 +1,60 @@
+#ifndef CARTRIDGE_H
+#define CARTRIDGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// https://www.nesdev.org/wiki/Mirroring#Nametable_Mirroring
+typedef enum Mirroring {
+  MIRRORING_HORIZONTAL,
+  MIRRORING_VERTICAL,
+  MIRRORING_SINGLE_SCREEN_0,
+  MIRRORING_SINGLE_SCREEN_1,
+} mirroring;
+
+typedef struct Cartridge {
+  // ROM images point into the caller's iNES image, which must outlive the
+  // cartridge
+  const uint8_t *prg_rom;
+  size_t prg_rom_size;
+  const uint8_t *chr_rom;
+  size_t chr_rom_size; // 0 if the board has CHR RAM
+
+  uint8_t mapper;
+  mirroring mirroring;
+  bool battery;
+
+  uint8_t prg_ram[0x2000];
+  uint8_t chr_ram[0x2000];
+  // mapped save file used instead of prg_ram if not NULL, see battery.h
+  uint8_t *battery_ram;
+} cartridge;
+
+// Load an iNES image. Returns false if the image is malformed or its mapper
+// is not supported.
+bool cartridge_load(cartridge *c, const uint8_t *rom, size_t size);
+
+// Hash of PRG ROM and CHR ROM, independent of the iNES header
+uint64_t cartridge_hash(const cartridge *c);
+
+// PRG RAM contents, from the save file if one is mapped
+const uint8_t *cartridge_prg_ram(const cartridge *c);
+
+// CPU $4020-$FFFF
+uint8_t cartridge_read_prg(cartridge *c, uint16_t addr);
+
+void cartridge_write_prg(cartridge *c, uint16_t addr, uint8_t val);
+
+// Memory behind the NES_PAGE_SIZE page at addr if the CPU can access it
+// directly, or NULL
+const uint8_t *cartridge_prg_read_page(const cartridge *c, uint16_t addr);
+
+uint8_t *cartridge_prg_write_page(cartridge *c, uint16_t addr);
+
+// PPU $0000-$1FFF
+uint8_t cartridge_read_chr(cartridge *c, uint16_t addr);
+
+void cartridge_write_chr(cartridge *c, uint16_t addr, uint8_t val);
+
+#endif // CARTRIDGE_H
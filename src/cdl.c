@@ -0,0 +1,74 @@
+#include "cdl.h"
+
+#include "bus.h"
+#include "cpu_disasm.h"
+
+size_t cdl_size(const cartridge *c) {
+  return c->prg_rom_size + c->chr_rom_size;
+}
+
+void cdl_attach(nes *n, cdl *c, uint8_t *log) {
+  *c = (cdl){.log = log, .size = cdl_size(&n->cartridge)};
+  n->cdl = c;
+  bus_map_pages(n);
+}
+
+void cdl_detach(nes *n) {
+  n->cdl = NULL;
+  bus_map_pages(n);
+}
+
+bool cdl_read(FILE *f, uint8_t *log, size_t size) {
+  return fread(log, 1, size, f) == size;
+}
+
+bool cdl_write(FILE *f, const uint8_t *log, size_t size) {
+  uint8_t buf[4096];
+  for (size_t i = 0; i < size; i += sizeof(buf)) {
+    size_t len = size - i < sizeof(buf) ? size - i : sizeof(buf);
+    for (size_t j = 0; j < len; j++) {
+      buf[j] = log[i + j] & ~CDL_OPCODE;
+    }
+    if (fwrite(buf, 1, len, f) != len) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void cdl_protect_pages(nes *n) {
+  // opcode fetches from RAM end the instruction in PRG ROM too
+  for (int page = 0; page < NES_PAGES; page++) {
+    n->read_pages[page] = NULL;
+  }
+}
+
+static uint8_t *flags(nes *n, uint16_t addr) {
+  const cartridge *c = &n->cartridge;
+  return &n->cdl->log[(addr - 0x8000) & (c->prg_rom_size - 1)];
+}
+
+static uint8_t bank(uint16_t addr) { return (addr >> 13 & 3) << 2; }
+
+void cdl_log_opcode(nes *n, uint16_t pc) {
+  cdl *c = n->cdl;
+  if (pc < 0x8000) {
+    c->length = 0; // no ROM byte belongs to this instruction
+    return;
+  }
+  uint8_t opcode = cartridge_read_prg(&n->cartridge, pc);
+  c->pc = pc;
+  c->length = cpu_instruction_length(opcode);
+  *flags(n, pc) |= CDL_CODE | CDL_OPCODE | bank(pc);
+  for (uint16_t i = 1; i < c->length && pc + i <= 0xFFFF; i++) {
+    *flags(n, pc + i) |= CDL_CODE | bank(pc + i);
+  }
+}
+
+void cdl_log_read(nes *n, uint16_t addr) {
+  const cdl *c = n->cdl;
+  if (addr < 0x8000 || (uint16_t)(addr - c->pc) < c->length) {
+    return;
+  }
+  *flags(n, addr) |= CDL_DATA | bank(addr);
+}
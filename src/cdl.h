@@ -0,0 +1,60 @@
+#ifndef CDL_H
+#define CDL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "nes.h"
+
+// Code/data logger
+// https://fceux.com/web/help/CodeDataLogger.html
+//
+// A log is one byte of flags per PRG ROM byte followed by one per CHR ROM
+// byte, as in FCEUX .cdl files. Only PRG ROM is logged; CHR flags stay as
+// loaded. While a logger is attached, the CPU page table has no pages to read
+// from, so every fetch and read is seen: ROM reads that are not part of the
+// current instruction are data, including reads by code running from RAM and
+// by OAM DMA.
+
+typedef enum CDLFlag {
+  CDL_CODE = 1 << 0, // opcode or operand
+  CDL_DATA = 1 << 1,
+  CDL_BANK = 3 << 2, // which 8KB window of $8000-$FFFF it was accessed at
+  CDL_INDIRECT_CODE = 1 << 4,
+  CDL_INDIRECT_DATA = 1 << 5,
+  CDL_PCM = 1 << 6,
+  // first byte of an instruction, only in memory: cleared by cdl_write()
+  CDL_OPCODE = 1 << 7,
+} cdl_flag;
+
+typedef struct CDL {
+  uint8_t *log; // caller-owned, cdl_size() bytes
+  size_t size;
+  // instruction being executed, whose operand bytes are not data
+  uint16_t pc;
+  uint8_t length;
+} cdl;
+
+// Size of a log for the cartridge
+size_t cdl_size(const cartridge *c);
+
+// Log into log, which is extended rather than cleared
+void cdl_attach(nes *n, cdl *c, uint8_t *log);
+
+void cdl_detach(nes *n);
+
+bool cdl_read(FILE *f, uint8_t *log, size_t size);
+
+bool cdl_write(FILE *f, const uint8_t *log, size_t size);
+
+// Leave the pages read out of the page table of n
+void cdl_protect_pages(nes *n);
+
+// From the CPU: an opcode fetch at pc, and any other read from a page left
+// out of the page table
+void cdl_log_opcode(nes *n, uint16_t pc);
+
+void cdl_log_read(nes *n, uint16_t addr);
+
+#endif // CDL_H
@@ -0,0 +1,22 @@
+#include "controller.h"
+
+void controller_write(controller *c, uint8_t val) {
+  c->strobe = val & 1;
+  if (c->strobe) {
+    c->shift = c->buttons;
+  }
+}
+
+uint8_t controller_read(controller *c) {
+  uint8_t bit = controller_peek(c);
+  if (c->strobe) {
+    return bit;
+  }
+  // official controllers return 1 after the 8 buttons
+  c->shift = (c->shift >> 1) | 0x80;
+  return bit;
+}
+
+uint8_t controller_peek(const controller *c) {
+  return (c->strobe ? c->buttons : c->shift) & 1;
+}
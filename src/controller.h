@@ -0,0 +1,34 @@
+#ifndef CONTROLLER_H
+#define CONTROLLER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// https://www.nesdev.org/wiki/Standard_controller
+typedef enum ControllerButton {
+  CONTROLLER_A = 1 << 0,
+  CONTROLLER_B = 1 << 1,
+  CONTROLLER_SELECT = 1 << 2,
+  CONTROLLER_START = 1 << 3,
+  CONTROLLER_UP = 1 << 4,
+  CONTROLLER_DOWN = 1 << 5,
+  CONTROLLER_LEFT = 1 << 6,
+  CONTROLLER_RIGHT = 1 << 7,
+} controller_button;
+
+typedef struct Controller {
+  uint8_t buttons; // controller_button bits currently pressed
+  uint8_t shift;   // report being shifted out
+  bool strobe;
+} controller;
+
+// $4016 write
+void controller_write(controller *c, uint8_t val);
+
+// $4016/$4017 read, bit 0 only
+uint8_t controller_read(controller *c);
+
+// controller_read() without shifting
+uint8_t controller_peek(const controller *c);
+
+#endif // CONTROLLER_H
@@ -18,6 +18,9 @@ typedef struct CPU {
 
   // clock cycle
   uintmax_t cycles;
+
+  // vector of the interrupt recognized at the last polling point, or 0
+  uint16_t interrupt_vector;
 } cpu;
 
 typedef enum CPUStatus {
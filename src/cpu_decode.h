@@ -16,33 +16,302 @@ typedef enum AddressingMode {
   INDIRECT, INDEXED_INDIRECT, INDIRECT_INDEXED, INDIRECT_INDEXED_WITH_PENALTY,
 } addressing_mode;
 
+#define CPU_MNEMONICS(X)                                  \
+  /* Load/Store Operations */                             \
+  X(LDA) X(LDX) X(LDY) X(STA) X(STX) X(STY)               \
+  /* Register Operations */                               \
+  X(TAX) X(TSX) X(TAY) X(TXA) X(TXS) X(TYA)               \
+  /* Stack instructions */                                \
+  X(PHA) X(PHP) X(PLA) X(PLP)                             \
+  /* Logical instructions */                              \
+  X(AND) X(EOR) X(ORA) X(BIT)                             \
+  /* Arithmetic instructions */                           \
+  X(ADC) X(SBC) X(CMP) X(CPX) X(CPY)                      \
+  /* Increment/Decrement instructions */                  \
+  X(INC) X(INX) X(INY) X(DEC) X(DEX) X(DEY)               \
+  /* Shift instructions */                                \
+  X(ASL) X(LSR) X(ROL) X(ROR)                             \
+  /* Jump instructions */                                 \
+  X(JMP) X(JSR) X(RTS) X(RTI)                             \
+  /* Branch instructions */                               \
+  X(BCC) X(BCS) X(BEQ) X(BMI) X(BNE) X(BPL) X(BVC) X(BVS) \
+  /* Flag control instructions */                         \
+  X(CLC) X(CLD) X(CLI) X(CLV) X(SEC) X(SED) X(SEI)        \
+  /* Misc */                                              \
+  X(BRK) X(NOP)                                           \
+  /* Unofficial */                                        \
+  X(LAX) X(SAX) X(DCP) X(ISB) X(SLO) X(RLA) X(SRE) X(RRA)
+
 typedef enum Mnemonic {
-  // Load/Store Operations,
-  LDA, LDX, LDY, STA, STX, STY,
-  // Register Operations,
-  TAX, TSX, TAY, TXA, TXS, TYA,
-  // Stack instructions,
-  PHA, PHP, PLA, PLP,
-  // Logical instructions,
-  AND, EOR, ORA, BIT,
-  // Arithmetic instructions,
-  ADC, SBC, CMP, CPX, CPY,
-  // Increment/Decrement instructions,
-  INC, INX, INY, DEC, DEX, DEY,
-  // Shift instructions,
-  ASL, LSR, ROL, ROR,
-  // Jump instructions,
-  JMP, JSR, RTS, RTI,
-  // Branch instructions,
-  BCC, BCS, BEQ, BMI, BNE, BPL, BVC, BVS,
-  // Flag control instructions,
-  CLC, CLD, CLI, CLV, SEC, SED, SEI,
-  // Misc,
-  BRK, NOP,
-  // Unofficial,
-  LAX, SAX, DCP, ISB, SLO, RLA, SRE, RRA,
+#define CPU_MNEMONIC_ENUM(m) m,
+  CPU_MNEMONICS(CPU_MNEMONIC_ENUM)
+#undef CPU_MNEMONIC_ENUM
 } mnemonic;
 
+// The opcode table: X(opcode, mnemonic, addressing mode, base cycles)
+//
+// This is the single source of truth for decoding. cpu_decode(), cpu_cycles(),
+// the disassembler and the specialized opcode handlers in cpu_step.c are all
+// generated from it. Base cycles exclude page crossing and branch penalties.
+// https://www.nesdev.org/wiki/CPU_unofficial_opcodes
+#define CPU_OPCODES(X) \
+  X(0x00, BRK, IMPLICIT,                      7)                   \
+  X(0x01, ORA, INDEXED_INDIRECT,              6)                   \
+  X(0x02, NOP, IMPLICIT,                      2) /* unsupported */ \
+  X(0x03, SLO, INDEXED_INDIRECT,              8)                   \
+  X(0x04, NOP, ZERO_PAGE,                     3)                   \
+  X(0x05, ORA, ZERO_PAGE,                     3)                   \
+  X(0x06, ASL, ZERO_PAGE,                     5)                   \
+  X(0x07, SLO, ZERO_PAGE,                     5)                   \
+  X(0x08, PHP, IMPLICIT,                      3)                   \
+  X(0x09, ORA, IMMEDIATE,                     2)                   \
+  X(0x0A, ASL, ACCUMULATOR,                   2)                   \
+  X(0x0B, NOP, IMPLICIT,                      2) /* unsupported */ \
+  X(0x0C, NOP, ABSOLUTE,                      4)                   \
+  X(0x0D, ORA, ABSOLUTE,                      4)                   \
+  X(0x0E, ASL, ABSOLUTE,                      6)                   \
+  X(0x0F, SLO, ABSOLUTE,                      6)                   \
+  X(0x10, BPL, RELATIVE,                      2)                   \
+  X(0x11, ORA, INDIRECT_INDEXED_WITH_PENALTY, 5)                   \
+  X(0x12, NOP, IMPLICIT,                      2) /* unsupported */ \
+  X(0x13, SLO, INDIRECT_INDEXED,              8)                   \
+  X(0x14, NOP, ZERO_PAGE_X,                   4)                   \
+  X(0x15, ORA, ZERO_PAGE_X,                   4)                   \
+  X(0x16, ASL, ZERO_PAGE_X,                   6)                   \
+  X(0x17, SLO, ZERO_PAGE_X,                   6)                   \
+  X(0x18, CLC, IMPLICIT,                      2)                   \
+  X(0x19, ORA, ABSOLUTE_Y_WITH_PENALTY,       4)                   \
+  X(0x1A, NOP, IMPLICIT,                      2)                   \
+  X(0x1B, SLO, ABSOLUTE_Y,                    7)                   \
+  X(0x1C, NOP, ABSOLUTE_X_WITH_PENALTY,       4)                   \
+  X(0x1D, ORA, ABSOLUTE_X_WITH_PENALTY,       4)                   \
+  X(0x1E, ASL, ABSOLUTE_X,                    7)                   \
+  X(0x1F, SLO, ABSOLUTE_X,                    7)                   \
+  X(0x20, JSR, ABSOLUTE,                      6)                   \
+  X(0x21, AND, INDEXED_INDIRECT,              6)                   \
+  X(0x22, NOP, IMPLICIT,                      2) /* unsupported */ \
+  X(0x23, RLA, INDEXED_INDIRECT,              8)                   \
+  X(0x24, BIT, ZERO_PAGE,                     3)                   \
+  X(0x25, AND, ZERO_PAGE,                     3)                   \
+  X(0x26, ROL, ZERO_PAGE,                     5)                   \
+  X(0x27, RLA, ZERO_PAGE,                     5)                   \
+  X(0x28, PLP, IMPLICIT,                      4)                   \
+  X(0x29, AND, IMMEDIATE,                     2)                   \
+  X(0x2A, ROL, ACCUMULATOR,                   2)                   \
+  X(0x2B, NOP, IMPLICIT,                      2) /* unsupported */ \
+  X(0x2C, BIT, ABSOLUTE,                      4)                   \
+  X(0x2D, AND, ABSOLUTE,                      4)                   \
+  X(0x2E, ROL, ABSOLUTE,                      6)                   \
+  X(0x2F, RLA, ABSOLUTE,                      6)                   \
+  X(0x30, BMI, RELATIVE,                      2)                   \
+  X(0x31, AND, INDIRECT_INDEXED_WITH_PENALTY, 5)                   \
+  X(0x32, NOP, IMPLICIT,                      2) /* unsupported */ \
+  X(0x33, RLA, INDIRECT_INDEXED,              8)                   \
+  X(0x34, NOP, ZERO_PAGE_X,                   4)                   \
+  X(0x35, AND, ZERO_PAGE_X,                   4)                   \
+  X(0x36, ROL, ZERO_PAGE_X,                   6)                   \
+  X(0x37, RLA, ZERO_PAGE_X,                   6)                   \
+  X(0x38, SEC, IMPLICIT,                      2)                   \
+  X(0x39, AND, ABSOLUTE_Y_WITH_PENALTY,       4)                   \
+  X(0x3A, NOP, IMPLICIT,                      2)                   \
+  X(0x3B, RLA, ABSOLUTE_Y,                    7)                   \
+  X(0x3C, NOP, ABSOLUTE_X_WITH_PENALTY,       4)                   \
+  X(0x3D, AND, ABSOLUTE_X_WITH_PENALTY,       4)                   \
+  X(0x3E, ROL, ABSOLUTE_X,                    7)                   \
+  X(0x3F, RLA, ABSOLUTE_X,                    7)                   \
+  X(0x40, RTI, IMPLICIT,                      6)                   \
+  X(0x41, EOR, INDEXED_INDIRECT,              6)                   \
+  X(0x42, NOP, IMPLICIT,                      2) /* unsupported */ \
+  X(0x43, SRE, INDEXED_INDIRECT,              8)                   \
+  X(0x44, NOP, ZERO_PAGE,                     3)                   \
+  X(0x45, EOR, ZERO_PAGE,                     3)                   \
+  X(0x46, LSR, ZERO_PAGE,                     5)                   \
+  X(0x47, SRE, ZERO_PAGE,                     5)                   \
+  X(0x48, PHA, IMPLICIT,                      3)                   \
+  X(0x49, EOR, IMMEDIATE,                     2)                   \
+  X(0x4A, LSR, ACCUMULATOR,                   2)                   \
+  X(0x4B, NOP, IMPLICIT,                      2) /* unsupported */ \
+  X(0x4C, JMP, ABSOLUTE,                      3)                   \
+  X(0x4D, EOR, ABSOLUTE,                      4)                   \
+  X(0x4E, LSR, ABSOLUTE,                      6)                   \
+  X(0x4F, SRE, ABSOLUTE,                      6)                   \
+  X(0x50, BVC, RELATIVE,                      2)                   \
+  X(0x51, EOR, INDIRECT_INDEXED_WITH_PENALTY, 5)                   \
+  X(0x52, NOP, IMPLICIT,                      2) /* unsupported */ \
+  X(0x53, SRE, INDIRECT_INDEXED,              8)                   \
+  X(0x54, NOP, ZERO_PAGE_X,                   4)                   \
+  X(0x55, EOR, ZERO_PAGE_X,                   4)                   \
+  X(0x56, LSR, ZERO_PAGE_X,                   6)                   \
+  X(0x57, SRE, ZERO_PAGE_X,                   6)                   \
+  X(0x58, CLI, IMPLICIT,                      2)                   \
+  X(0x59, EOR, ABSOLUTE_Y_WITH_PENALTY,       4)                   \
+  X(0x5A, NOP, IMPLICIT,                      2)                   \
+  X(0x5B, SRE, ABSOLUTE_Y,                    7)                   \
+  X(0x5C, NOP, ABSOLUTE_X_WITH_PENALTY,       4)                   \
+  X(0x5D, EOR, ABSOLUTE_X_WITH_PENALTY,       4)                   \
+  X(0x5E, LSR, ABSOLUTE_X,                    7)                   \
+  X(0x5F, SRE, ABSOLUTE_X,                    7)                   \
+  X(0x60, RTS, IMPLICIT,                      6)                   \
+  X(0x61, ADC, INDEXED_INDIRECT,              6)                   \
+  X(0x62, NOP, IMPLICIT,                      2) /* unsupported */ \
+  X(0x63, RRA, INDEXED_INDIRECT,              8)                   \
+  X(0x64, NOP, ZERO_PAGE,                     3)                   \
+  X(0x65, ADC, ZERO_PAGE,                     3)                   \
+  X(0x66, ROR, ZERO_PAGE,                     5)                   \
+  X(0x67, RRA, ZERO_PAGE,                     5)                   \
+  X(0x68, PLA, IMPLICIT,                      4)                   \
+  X(0x69, ADC, IMMEDIATE,                     2)                   \
+  X(0x6A, ROR, ACCUMULATOR,                   2)                   \
+  X(0x6B, NOP, IMPLICIT,                      2) /* unsupported */ \
+  X(0x6C, JMP, INDIRECT,                      5)                   \
+  X(0x6D, ADC, ABSOLUTE,                      4)                   \
+  X(0x6E, ROR, ABSOLUTE,                      6)                   \
+  X(0x6F, RRA, ABSOLUTE,                      6)                   \
+  X(0x70, BVS, RELATIVE,                      2)                   \
+  X(0x71, ADC, INDIRECT_INDEXED_WITH_PENALTY, 5)                   \
+  X(0x72, NOP, IMPLICIT,                      2) /* unsupported */ \
+  X(0x73, RRA, INDIRECT_INDEXED,              8)                   \
+  X(0x74, NOP, ZERO_PAGE_X,                   4)                   \
+  X(0x75, ADC, ZERO_PAGE_X,                   4)                   \
+  X(0x76, ROR, ZERO_PAGE_X,                   6)                   \
+  X(0x77, RRA, ZERO_PAGE_X,                   6)                   \
+  X(0x78, SEI, IMPLICIT,                      2)                   \
+  X(0x79, ADC, ABSOLUTE_Y_WITH_PENALTY,       4)                   \
+  X(0x7A, NOP, IMPLICIT,                      2)                   \
+  X(0x7B, RRA, ABSOLUTE_Y,                    7)                   \
+  X(0x7C, NOP, ABSOLUTE_X_WITH_PENALTY,       4)                   \
+  X(0x7D, ADC, ABSOLUTE_X_WITH_PENALTY,       4)                   \
+  X(0x7E, ROR, ABSOLUTE_X,                    7)                   \
+  X(0x7F, RRA, ABSOLUTE_X,                    7)                   \
+  X(0x80, NOP, IMMEDIATE,                     2)                   \
+  X(0x81, STA, INDEXED_INDIRECT,              6)                   \
+  X(0x82, NOP, IMMEDIATE,                     2)                   \
+  X(0x83, SAX, INDEXED_INDIRECT,              6)                   \
+  X(0x84, STY, ZERO_PAGE,                     3)                   \
+  X(0x85, STA, ZERO_PAGE,                     3)                   \
+  X(0x86, STX, ZERO_PAGE,                     3)                   \
+  X(0x87, SAX, ZERO_PAGE,                     3)                   \
+  X(0x88, DEY, IMPLICIT,                      2)                   \
+  X(0x89, NOP, IMMEDIATE,                     2)                   \
+  X(0x8A, TXA, IMPLICIT,                      2)                   \
+  X(0x8B, NOP, IMPLICIT,                      2) /* unsupported */ \
+  X(0x8C, STY, ABSOLUTE,                      4)                   \
+  X(0x8D, STA, ABSOLUTE,                      4)                   \
+  X(0x8E, STX, ABSOLUTE,                      4)                   \
+  X(0x8F, SAX, ABSOLUTE,                      4)                   \
+  X(0x90, BCC, RELATIVE,                      2)                   \
+  X(0x91, STA, INDIRECT_INDEXED,              6)                   \
+  X(0x92, NOP, IMPLICIT,                      2) /* unsupported */ \
+  X(0x93, NOP, IMPLICIT,                      2) /* unsupported */ \
+  X(0x94, STY, ZERO_PAGE_X,                   4)                   \
+  X(0x95, STA, ZERO_PAGE_X,                   4)                   \
+  X(0x96, STX, ZERO_PAGE_Y,                   4)                   \
+  X(0x97, SAX, ZERO_PAGE_Y,                   4)                   \
+  X(0x98, TYA, IMPLICIT,                      2)                   \
+  X(0x99, STA, ABSOLUTE_Y,                    5)                   \
+  X(0x9A, TXS, IMPLICIT,                      2)                   \
+  X(0x9B, NOP, IMPLICIT,                      2) /* unsupported */ \
+  X(0x9C, NOP, IMPLICIT,                      2) /* unsupported */ \
+  X(0x9D, STA, ABSOLUTE_X,                    5)                   \
+  X(0x9E, NOP, IMPLICIT,                      2) /* unsupported */ \
+  X(0x9F, NOP, IMPLICIT,                      2) /* unsupported */ \
+  X(0xA0, LDY, IMMEDIATE,                     2)                   \
+  X(0xA1, LDA, INDEXED_INDIRECT,              6)                   \
+  X(0xA2, LDX, IMMEDIATE,                     2)                   \
+  X(0xA3, LAX, INDEXED_INDIRECT,              6)                   \
+  X(0xA4, LDY, ZERO_PAGE,                     3)                   \
+  X(0xA5, LDA, ZERO_PAGE,                     3)                   \
+  X(0xA6, LDX, ZERO_PAGE,                     3)                   \
+  X(0xA7, LAX, ZERO_PAGE,                     3)                   \
+  X(0xA8, TAY, IMPLICIT,                      2)                   \
+  X(0xA9, LDA, IMMEDIATE,                     2)                   \
+  X(0xAA, TAX, IMPLICIT,                      2)                   \
+  X(0xAB, LAX, IMMEDIATE,                     2)                   \
+  X(0xAC, LDY, ABSOLUTE,                      4)                   \
+  X(0xAD, LDA, ABSOLUTE,                      4)                   \
+  X(0xAE, LDX, ABSOLUTE,                      4)                   \
+  X(0xAF, LAX, ABSOLUTE,                      4)                   \
+  X(0xB0, BCS, RELATIVE,                      2)                   \
+  X(0xB1, LDA, INDIRECT_INDEXED_WITH_PENALTY, 5)                   \
+  X(0xB2, NOP, IMPLICIT,                      2) /* unsupported */ \
+  X(0xB3, LAX, INDIRECT_INDEXED_WITH_PENALTY, 5)                   \
+  X(0xB4, LDY, ZERO_PAGE_X,                   4)                   \
+  X(0xB5, LDA, ZERO_PAGE_X,                   4)                   \
+  X(0xB6, LDX, ZERO_PAGE_Y,                   4)                   \
+  X(0xB7, LAX, ZERO_PAGE_Y,                   4)                   \
+  X(0xB8, CLV, IMPLICIT,                      2)                   \
+  X(0xB9, LDA, ABSOLUTE_Y_WITH_PENALTY,       4)                   \
+  X(0xBA, TSX, IMPLICIT,                      2)                   \
+  X(0xBB, NOP, IMPLICIT,                      2) /* unsupported */ \
+  X(0xBC, LDY, ABSOLUTE_X_WITH_PENALTY,       4)                   \
+  X(0xBD, LDA, ABSOLUTE_X_WITH_PENALTY,       4)                   \
+  X(0xBE, LDX, ABSOLUTE_Y_WITH_PENALTY,       4)                   \
+  X(0xBF, LAX, ABSOLUTE_Y_WITH_PENALTY,       4)                   \
+  X(0xC0, CPY, IMMEDIATE,                     2)                   \
+  X(0xC1, CMP, INDEXED_INDIRECT,              6)                   \
+  X(0xC2, NOP, IMMEDIATE,                     2)                   \
+  X(0xC3, DCP, INDEXED_INDIRECT,              8)                   \
+  X(0xC4, CPY, ZERO_PAGE,                     3)                   \
+  X(0xC5, CMP, ZERO_PAGE,                     3)                   \
+  X(0xC6, DEC, ZERO_PAGE,                     5)                   \
+  X(0xC7, DCP, ZERO_PAGE,                     5)                   \
+  X(0xC8, INY, IMPLICIT,                      2)                   \
+  X(0xC9, CMP, IMMEDIATE,                     2)                   \
+  X(0xCA, DEX, IMPLICIT,                      2)                   \
+  X(0xCB, NOP, IMPLICIT,                      2) /* unsupported */ \
+  X(0xCC, CPY, ABSOLUTE,                      4)                   \
+  X(0xCD, CMP, ABSOLUTE,                      4)                   \
+  X(0xCE, DEC, ABSOLUTE,                      6)                   \
+  X(0xCF, DCP, ABSOLUTE,                      6)                   \
+  X(0xD0, BNE, RELATIVE,                      2)                   \
+  X(0xD1, CMP, INDIRECT_INDEXED_WITH_PENALTY, 5)                   \
+  X(0xD2, NOP, IMPLICIT,                      2) /* unsupported */ \
+  X(0xD3, DCP, INDIRECT_INDEXED,              8)                   \
+  X(0xD4, NOP, ZERO_PAGE_X,                   4)                   \
+  X(0xD5, CMP, ZERO_PAGE_X,                   4)                   \
+  X(0xD6, DEC, ZERO_PAGE_X,                   6)                   \
+  X(0xD7, DCP, ZERO_PAGE_X,                   6)                   \
+  X(0xD8, CLD, IMPLICIT,                      2)                   \
+  X(0xD9, CMP, ABSOLUTE_Y_WITH_PENALTY,       4)                   \
+  X(0xDA, NOP, IMPLICIT,                      2)                   \
+  X(0xDB, DCP, ABSOLUTE_Y,                    7)                   \
+  X(0xDC, NOP, ABSOLUTE_X_WITH_PENALTY,       4)                   \
+  X(0xDD, CMP, ABSOLUTE_X_WITH_PENALTY,       4)                   \
+  X(0xDE, DEC, ABSOLUTE_X,                    7)                   \
+  X(0xDF, DCP, ABSOLUTE_X,                    7)                   \
+  X(0xE0, CPX, IMMEDIATE,                     2)                   \
+  X(0xE1, SBC, INDEXED_INDIRECT,              6)                   \
+  X(0xE2, NOP, IMMEDIATE,                     2)                   \
+  X(0xE3, ISB, INDEXED_INDIRECT,              8)                   \
+  X(0xE4, CPX, ZERO_PAGE,                     3)                   \
+  X(0xE5, SBC, ZERO_PAGE,                     3)                   \
+  X(0xE6, INC, ZERO_PAGE,                     5)                   \
+  X(0xE7, ISB, ZERO_PAGE,                     5)                   \
+  X(0xE8, INX, IMPLICIT,                      2)                   \
+  X(0xE9, SBC, IMMEDIATE,                     2)                   \
+  X(0xEA, NOP, IMPLICIT,                      2)                   \
+  X(0xEB, SBC, IMMEDIATE,                     2)                   \
+  X(0xEC, CPX, ABSOLUTE,                      4)                   \
+  X(0xED, SBC, ABSOLUTE,                      4)                   \
+  X(0xEE, INC, ABSOLUTE,                      6)                   \
+  X(0xEF, ISB, ABSOLUTE,                      6)                   \
+  X(0xF0, BEQ, RELATIVE,                      2)                   \
+  X(0xF1, SBC, INDIRECT_INDEXED_WITH_PENALTY, 5)                   \
+  X(0xF2, NOP, IMPLICIT,                      2) /* unsupported */ \
+  X(0xF3, ISB, INDIRECT_INDEXED,              8)                   \
+  X(0xF4, NOP, ZERO_PAGE_X,                   4)                   \
+  X(0xF5, SBC, ZERO_PAGE_X,                   4)                   \
+  X(0xF6, INC, ZERO_PAGE_X,                   6)                   \
+  X(0xF7, ISB, ZERO_PAGE_X,                   6)                   \
+  X(0xF8, SED, IMPLICIT,                      2)                   \
+  X(0xF9, SBC, ABSOLUTE_Y_WITH_PENALTY,       4)                   \
+  X(0xFA, NOP, IMPLICIT,                      2)                   \
+  X(0xFB, ISB, ABSOLUTE_Y,                    7)                   \
+  X(0xFC, NOP, ABSOLUTE_X_WITH_PENALTY,       4)                   \
+  X(0xFD, SBC, ABSOLUTE_X_WITH_PENALTY,       4)                   \
+  X(0xFE, INC, ABSOLUTE_X,                    7)                   \
+  X(0xFF, ISB, ABSOLUTE_X,                    7)
+
 // clang-format on
 
 typedef struct CPUInstruction {
@@ -52,5 +321,8 @@ typedef struct CPUInstruction {
 
 cpu_instruction cpu_decode(uint8_t opcode);
 
-#endif // CPU_DECODE_H
+uint8_t cpu_cycles(uint8_t opcode);
 
+const char *cpu_mnemonic_name(mnemonic m);
+
+#endif // CPU_DECODE_H
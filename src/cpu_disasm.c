@@ -0,0 +1,89 @@
+#include "cpu_disasm.h"
+
+#include <stdio.h>
+
+#include "cpu_decode.h"
+
+static uint8_t operand_length(addressing_mode mode) {
+  switch (mode) {
+  case IMPLICIT:
+  case ACCUMULATOR:
+    return 0;
+  case IMMEDIATE:
+  case ZERO_PAGE:
+  case ZERO_PAGE_X:
+  case ZERO_PAGE_Y:
+  case RELATIVE:
+  case INDEXED_INDIRECT:
+  case INDIRECT_INDEXED:
+  case INDIRECT_INDEXED_WITH_PENALTY:
+    return 1;
+  case ABSOLUTE:
+  case ABSOLUTE_X:
+  case ABSOLUTE_X_WITH_PENALTY:
+  case ABSOLUTE_Y:
+  case ABSOLUTE_Y_WITH_PENALTY:
+  case INDIRECT:
+    return 2;
+  }
+  return 0;
+}
+
+uint8_t cpu_instruction_length(uint8_t opcode) {
+  return 1 + operand_length(cpu_decode(opcode).mode);
+}
+
+uint8_t cpu_disassemble(uint16_t pc, const uint8_t *bytes, char *buf,
+                        size_t len) {
+  cpu_instruction inst = cpu_decode(bytes[0]);
+  const char *name = cpu_mnemonic_name(inst.mnemonic);
+  uint8_t length = operand_length(inst.mode);
+  uint8_t b = 0 < length ? bytes[1] : 0;
+  uint16_t w = length == 2 ? b | bytes[2] << 8 : b;
+
+  switch (inst.mode) {
+  case IMPLICIT:
+    snprintf(buf, len, "%s", name);
+    break;
+  case ACCUMULATOR:
+    snprintf(buf, len, "%s A", name);
+    break;
+  case IMMEDIATE:
+    snprintf(buf, len, "%s #$%02X", name, b);
+    break;
+  case ZERO_PAGE:
+    snprintf(buf, len, "%s $%02X", name, b);
+    break;
+  case ZERO_PAGE_X:
+    snprintf(buf, len, "%s $%02X,X", name, b);
+    break;
+  case ZERO_PAGE_Y:
+    snprintf(buf, len, "%s $%02X,Y", name, b);
+    break;
+  case ABSOLUTE:
+    snprintf(buf, len, "%s $%04X", name, w);
+    break;
+  case ABSOLUTE_X:
+  case ABSOLUTE_X_WITH_PENALTY:
+    snprintf(buf, len, "%s $%04X,X", name, w);
+    break;
+  case ABSOLUTE_Y:
+  case ABSOLUTE_Y_WITH_PENALTY:
+    snprintf(buf, len, "%s $%04X,Y", name, w);
+    break;
+  case RELATIVE:
+    snprintf(buf, len, "%s $%04X", name, (uint16_t)(pc + 2 + (int8_t)b));
+    break;
+  case INDIRECT:
+    snprintf(buf, len, "%s ($%04X)", name, w);
+    break;
+  case INDEXED_INDIRECT:
+    snprintf(buf, len, "%s ($%02X,X)", name, b);
+    break;
+  case INDIRECT_INDEXED:
+  case INDIRECT_INDEXED_WITH_PENALTY:
+    snprintf(buf, len, "%s ($%02X),Y", name, b);
+    break;
+  }
+  return 1 + length;
+}
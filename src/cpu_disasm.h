@@ -0,0 +1,15 @@
+#ifndef CPU_DISASM_H
+#define CPU_DISASM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Length in bytes of the instruction starting with opcode
+uint8_t cpu_instruction_length(uint8_t opcode);
+
+// Disassemble the instruction at pc into buf, and return its length in bytes.
+// bytes holds the opcode followed by its operand bytes.
+uint8_t cpu_disassemble(uint16_t pc, const uint8_t *bytes, char *buf,
+                        size_t len);
+
+#endif // CPU_DISASM_H
@@ -1,27 +1,92 @@
 #include "cpu_step.h"
 
-#include <stdio.h>
-
+#include "cdl.h"
 #include "cpu_decode.h"
+#include "debugger.h"
 #include "memory_map.h"
 
+// Cycle accounting
+//
+// The cycle-exact core (default) charges every bus access and every dummy
+// cycle through cpu_tick(), which steps other components in lockstep. The
+// instruction-granular core (XNES_INSTRUCTION_GRANULAR) makes cpu_tick() free,
+// charges the whole instruction from cpu_cycles() in cpu_charge() and catches
+// other components up in cpu_sync() at the instruction boundary.
+// Page crossing and branch penalties are not in cpu_cycles(), so they are
+// charged by cpu_penalty() in both cores.
+#ifdef XNES_INSTRUCTION_GRANULAR
 static void cpu_tick(nes *n) {
-  /* nes_tick(n); */
+  (void)n;
+}
+
+static void cpu_charge(nes *n, uint8_t cycles) { n->cpu.cycles += cycles; }
+
+static void cpu_penalty(nes *n) { n->cpu.cycles++; }
+
+static void cpu_sync(nes *n, uintmax_t since) {
+  for (uintmax_t c = since; c < n->cpu.cycles; c++) {
+    nes_tick(n);
+  }
+}
+#else
+static void cpu_tick(nes *n) {
+  nes_tick(n);
   n->cpu.cycles++;
 }
 
-static uint8_t cpu_read(nes *n, uint16_t addr) {
+static void cpu_charge(nes *n, uint8_t cycles) {
+  (void)n;
+  (void)cycles;
+}
+
+static void cpu_penalty(nes *n) { cpu_tick(n); }
+
+static void cpu_sync(nes *n, uintmax_t since) {
+  (void)n;
+  (void)since;
+}
+#endif
+
+// Accesses to pages not in the page table go through the bus, and through
+// the logger and the debugger if attached.
+
+static uint8_t read_untimed(nes *n, uint16_t addr) {
+  const uint8_t *page = n->read_pages[addr >> NES_PAGE_BITS];
+  if (page) {
+    return page[addr & (NES_PAGE_SIZE - 1)];
+  }
   uint8_t m = mem_read(n, addr);
+  if (n->cdl) {
+    cdl_log_read(n, addr);
+  }
+  if (n->debugger) {
+    debugger_check(n, addr, DEBUG_READ, m);
+  }
+  return m;
+}
+
+static uint8_t cpu_read(nes *n, uint16_t addr) {
+  uint8_t m = read_untimed(n, addr);
   cpu_tick(n);
   return m;
 }
 
+uint8_t cpu_dma_read(nes *n, uint16_t addr) { return read_untimed(n, addr); }
+
 static uint16_t cpu_read_word(nes *n, uint16_t addr) {
   return cpu_read(n, addr) | cpu_read(n, addr + 1) << 8;
 }
 
 static void cpu_write(nes *n, uint16_t addr, uint8_t val) {
-  mem_write(n, addr, val);
+  uint8_t *page = n->write_pages[addr >> NES_PAGE_BITS];
+  if (page) {
+    page[addr & (NES_PAGE_SIZE - 1)] = val;
+  } else {
+    mem_write(n, addr, val);
+    if (n->debugger) {
+      debugger_check(n, addr, DEBUG_WRITE, val);
+    }
+  }
   cpu_tick(n);
 }
 
@@ -38,7 +103,6 @@ void cpu_power_on(nes *n) {
 
 void cpu_reset(nes *n) {
   n->cpu.PC = cpu_read_word(n, 0xFFFC);
-  printf("initial PC: %x\n", n->cpu.PC);
   n->cpu.P = CPU_STATUS_I;
   n->cpu.S -= 3;
 }
@@ -58,20 +122,29 @@ static void push_stack_word(nes *n, uint16_t v) {
 static uint8_t cpu_status_interrupt_b = 0b00100000;
 static uint8_t cpu_status_instruction_b = 0b00110000;
 
+// Interrupts are polled at the end of each instruction and the recognized one
+// is serviced before the next opcode fetch.
+// https://www.nesdev.org/wiki/CPU_interrupts#Detailed_interrupt_behavior
+//
+// CLI, SEI and PLP change the I flag after the polling point, so the poll sees
+// the I flag from before the instruction (p).
+static void poll_interrupt(nes *n, uint8_t op, uint8_t p) {
+  if (n->interrupt & INTERRUPT_NMI) {
+    n->cpu.interrupt_vector = 0xFFFA;
+    return;
+  }
+  if (op != 0x58 && op != 0x78 && op != 0x28) {
+    p = n->cpu.P;
+  }
+  if ((n->interrupt & INTERRUPT_IRQ) && !(p & (1 << CPU_STATUS_I))) {
+    n->cpu.interrupt_vector = 0xFFFE;
+  }
+}
+
 static void handle_interrupt(nes *n) {
-  uint16_t vector;
-  switch (n->interrupt) {
-  case INTERRUPT_NONE:
-    return; // not interrupted
-  case INTERRUPT_NMI:
-    vector = 0xFFFA;
-    break; // interrupted
-  case INTERRUPT_IRQ:
-    if (!cpu_status_enabled(&n->cpu, CPU_STATUS_I)) {
-      return; // not interrupted
-    }
-    vector = 0xFFFE;
-    break; // interrupted
+  uint16_t vector = n->cpu.interrupt_vector;
+  if (vector == 0xFFFA) {
+    n->interrupt &= ~INTERRUPT_NMI; // NMI is edge-triggered
   }
 
   cpu_tick(n);
@@ -82,7 +155,8 @@ static void handle_interrupt(nes *n) {
   push_stack(n, n->cpu.P | cpu_status_interrupt_b);
   cpu_status_set(&n->cpu, CPU_STATUS_I, true);
   n->cpu.PC = cpu_read_word(n, vector);
-  n->interrupt = INTERRUPT_NONE;
+  n->cpu.interrupt_vector = 0;
+  cpu_charge(n, 7);
 }
 
 uint16_t read_on_indirect(nes *n, uint16_t addr) {
@@ -97,7 +171,12 @@ static bool is_page_crossed(uint16_t a, uint16_t b) {
   return ((a + b) & 0xFF00) != (b & 0xFF00);
 }
 
-static uint16_t get_operand(nes *n, addressing_mode mode) {
+// get_operand() and execute() are always inlined into the opcode handlers
+// generated below, where mnemonic and mode are constants, so that each handler
+// is specialized down to its own addressing mode and operation.
+#define CPU_SPECIALIZE static inline __attribute__((always_inline))
+
+CPU_SPECIALIZE uint16_t get_operand(nes *n, addressing_mode mode) {
   switch (mode) {
   case IMPLICIT:
     return 0;
@@ -137,7 +216,7 @@ static uint16_t get_operand(nes *n, addressing_mode mode) {
     uint16_t value = cpu_read_word(n, n->cpu.PC);
     n->cpu.PC += 2;
     if (is_page_crossed(n->cpu.X, value)) {
-      cpu_tick(n);
+      cpu_penalty(n);
     }
     return value + n->cpu.X;
   }
@@ -151,7 +230,7 @@ static uint16_t get_operand(nes *n, addressing_mode mode) {
     uint16_t value = cpu_read_word(n, n->cpu.PC);
     n->cpu.PC += 2;
     if (is_page_crossed(n->cpu.Y, value)) {
-      cpu_tick(n);
+      cpu_penalty(n);
     }
     return value + n->cpu.Y;
   }
@@ -185,7 +264,7 @@ static uint16_t get_operand(nes *n, addressing_mode mode) {
     uint16_t value = read_on_indirect(n, m);
     n->cpu.PC++;
     if (is_page_crossed(n->cpu.Y, value)) {
-      cpu_tick(n);
+      cpu_penalty(n);
     }
     return value + n->cpu.Y;
   }
@@ -216,7 +295,7 @@ static void branch(nes *n, uint8_t v);
 
 static void set_carry_status(nes *n, uint8_t m, uint8_t r);
 
-static void execute(nes *n, cpu_instruction inst) {
+CPU_SPECIALIZE void execute(nes *n, cpu_instruction inst) {
   uint16_t operand = get_operand(n, inst.mode);
 
   switch (inst.mnemonic) {
@@ -581,15 +660,61 @@ static void execute(nes *n, cpu_instruction inst) {
   }
 }
 
+// One handler per opcode, generated from CPU_OPCODES
+#define CPU_OPCODE_HANDLER(opcode, mnemonic, mode, cycles)                     \
+  static void cpu_op_##opcode(nes *n) {                                        \
+    execute(n, (cpu_instruction){mnemonic, mode});                             \
+    cpu_charge(n, cycles);                                                     \
+  }
+CPU_OPCODES(CPU_OPCODE_HANDLER)
+#undef CPU_OPCODE_HANDLER
+
+static const cpu_op_handler handlers[256] = {
+#define CPU_OPCODE_HANDLER_ENTRY(opcode, mnemonic, mode, cycles)               \
+  [opcode] = cpu_op_##opcode,
+    CPU_OPCODES(CPU_OPCODE_HANDLER_ENTRY)
+#undef CPU_OPCODE_HANDLER_ENTRY
+};
+
+cpu_op_handler cpu_handler(uint8_t opcode) { return handlers[opcode]; }
+
 void cpu_step(nes *n) {
-  handle_interrupt(n);
+  uintmax_t start = n->cpu.cycles;
+
+  if (n->cpu.interrupt_vector) {
+    handle_interrupt(n);
+  }
+
+  uint8_t p = n->cpu.P;
 
   // fetch
-  uint8_t op = cpu_read(n, n->cpu.PC);
+  const uint8_t *page = n->read_pages[n->cpu.PC >> NES_PAGE_BITS];
+  uint8_t op;
+  if (page) {
+    op = page[n->cpu.PC & (NES_PAGE_SIZE - 1)];
+  } else {
+    if (n->debugger && debugger_check(n, n->cpu.PC, DEBUG_EXECUTE, 0)) {
+      cpu_sync(n, start);
+      return; // stopped before the instruction
+    }
+    if (n->cdl) {
+      cdl_log_opcode(n, n->cpu.PC);
+    }
+    op = mem_read(n, n->cpu.PC);
+  }
+  cpu_tick(n);
   n->cpu.PC++;
 
-  cpu_instruction inst = cpu_decode(op);
-  execute(n, inst);
+  handlers[op](n);
+
+  for (; n->cpu_stall; n->cpu_stall--) {
+    cpu_penalty(n);
+  }
+  cpu_sync(n, start);
+
+  if (n->interrupt) {
+    poll_interrupt(n, op, p);
+  }
 }
 
 void and (nes * n, uint16_t v) {
@@ -672,11 +797,11 @@ void ror(nes *n, uint8_t *m) {
 }
 
 void branch(nes *n, uint8_t v) {
-  cpu_tick(n);
+  cpu_penalty(n);
   int16_t base = (int16_t)n->cpu.PC;
   int8_t offset = (int8_t)v; // to negative number
   if (is_page_crossed(offset, base)) {
-    cpu_tick(n);
+    cpu_penalty(n);
   }
   n->cpu.PC = base + (int16_t)offset;
 }
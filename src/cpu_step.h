@@ -9,4 +9,13 @@ void cpu_reset(nes *n);
 
 void cpu_step(nes *n);
 
+// A read by DMA, seen by the loggers and the debugger as a CPU read. DMA
+// charges its cycles as a stall.
+uint8_t cpu_dma_read(nes *n, uint16_t addr);
+
+typedef void (*cpu_op_handler)(nes *n);
+
+// The handler of an opcode, generated from CPU_OPCODES. For tests.
+cpu_op_handler cpu_handler(uint8_t opcode);
+
 #endif // CPU_STEP_H
@@ -0,0 +1,80 @@
+#include "debugger.h"
+
+#include <string.h>
+
+#include "bus.h"
+
+void debugger_attach(nes *n, debugger *d, debug_hook hook, void *ctx) {
+  memset(d, 0, sizeof(*d));
+  d->hook = hook;
+  d->ctx = ctx;
+  d->resume_cycles = UINTMAX_MAX;
+  n->debugger = d;
+  bus_map_pages(n);
+}
+
+void debugger_detach(nes *n) {
+  n->debugger = NULL;
+  bus_map_pages(n);
+}
+
+int debugger_watch(nes *n, uint16_t start, uint16_t end, uint8_t access) {
+  debugger *d = n->debugger;
+  for (int i = 0; i < DEBUGGER_POINTS; i++) {
+    if (!d->points[i].access) {
+      d->points[i] = (debug_point){start, end, access};
+      debugger_protect_pages(n);
+      return i;
+    }
+  }
+  return -1;
+}
+
+void debugger_unwatch(nes *n, int point) {
+  n->debugger->points[point].access = 0;
+  bus_map_pages(n);
+}
+
+void debugger_protect_pages(nes *n) {
+  debugger *d = n->debugger;
+  for (int i = 0; i < DEBUGGER_POINTS; i++) {
+    const debug_point *p = &d->points[i];
+    if (!p->access) {
+      continue;
+    }
+    for (int page = p->start >> NES_PAGE_BITS;
+         page <= p->end >> NES_PAGE_BITS; page++) {
+      if (p->access & (DEBUG_READ | DEBUG_EXECUTE)) {
+        n->read_pages[page] = NULL;
+      }
+      if (p->access & DEBUG_WRITE) {
+        n->write_pages[page] = NULL;
+      }
+    }
+  }
+}
+
+bool debugger_check(nes *n, uint16_t addr, debug_access access, uint8_t value) {
+  debugger *d = n->debugger;
+  if (access == DEBUG_EXECUTE && d->resume_pc == addr &&
+      d->resume_cycles == n->cpu.cycles) {
+    return false;
+  }
+
+  for (int i = 0; i < DEBUGGER_POINTS; i++) {
+    const debug_point *p = &d->points[i];
+    if (!(p->access & access) || addr < p->start || p->end < addr) {
+      continue;
+    }
+    d->last = (debug_event){addr, access, value, i};
+    if (!d->hook || d->hook(n, &d->last, d->ctx)) {
+      n->debug_stop = true;
+      if (access == DEBUG_EXECUTE) {
+        d->resume_pc = addr;
+        d->resume_cycles = n->cpu.cycles;
+      }
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,76 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nes.h"
+
+// Breakpoints and watchpoints
+//
+// Pages of the CPU page table covering a watched range are left unmapped, so
+// only accesses to them reach the bus and get checked; every other access
+// costs the same as without a debugger. A PC breakpoint is an execute
+// watchpoint on a single address, checked before the instruction there runs.
+//
+// Addresses are matched as issued by the CPU, so a watchpoint on RAM does not
+// cover its mirrors.
+
+typedef enum DebugAccess {
+  DEBUG_READ = 1 << 0,
+  DEBUG_WRITE = 1 << 1,
+  DEBUG_EXECUTE = 1 << 2,
+} debug_access;
+
+typedef struct DebugEvent {
+  uint16_t addr;
+  debug_access access;
+  uint8_t value; // read or written, 0 for DEBUG_EXECUTE
+  int point;     // index returned by debugger_watch()
+} debug_event;
+
+// Called on every hit. Returning true stops the running frame, see
+// nes_frame.stopped.
+typedef bool (*debug_hook)(nes *n, const debug_event *e, void *ctx);
+
+#define DEBUGGER_POINTS 16
+
+typedef struct DebugPoint {
+  uint16_t start, end; // inclusive
+  uint8_t access;      // debug_access bits, 0 if the slot is free
+} debug_point;
+
+typedef struct Debugger {
+  debug_point points[DEBUGGER_POINTS];
+  debug_hook hook; // NULL to stop on every hit
+  void *ctx;
+
+  debug_event last; // last hit
+  // an execute hit stops before the instruction, which must not hit again
+  // when the frame resumes at the same cycle
+  uint16_t resume_pc;
+  uintmax_t resume_cycles;
+} debugger;
+
+// Attach d to n, both owned by the caller, and remap the pages of n
+void debugger_attach(nes *n, debugger *d, debug_hook hook, void *ctx);
+
+void debugger_detach(nes *n);
+
+// Watch start-end for debug_access bits. Returns the point index, or -1 if
+// all DEBUGGER_POINTS are in use.
+int debugger_watch(nes *n, uint16_t start, uint16_t end, uint8_t access);
+
+static inline int debugger_break(nes *n, uint16_t pc) {
+  return debugger_watch(n, pc, pc, DEBUG_EXECUTE);
+}
+
+void debugger_unwatch(nes *n, int point);
+
+// Unmap the pages of n watched for access
+void debugger_protect_pages(nes *n);
+
+// Check an access to an unmapped page, from the CPU. Returns true to stop.
+bool debugger_check(nes *n, uint16_t addr, debug_access access, uint8_t value);
+
+#endif // DEBUGGER_H
@@ -0,0 +1,176 @@
+#include "envs.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "observer.h"
+#include "pool.h"
+
+struct Envs {
+  envs_options o;
+  nes start; // saved state episodes begin from
+  uint8_t *start_observation;
+  size_t observation_size;
+  nes *machines;
+  observer observer;
+  uint8_t *stacks; // frame stacks by machine for ENVS_OBSERVE_GRAYSCALE
+  pool *pool;
+
+  // batch in progress
+  const uint8_t *actions;
+  uint8_t *obs;
+  float *rewards;
+  bool *dones;
+};
+
+static void reset_env(envs *e, size_t i) {
+  nes_load_state(&e->machines[i], &e->start);
+  memcpy(e->obs + i * e->observation_size, e->start_observation,
+         e->observation_size);
+  if (e->stacks) {
+    memcpy(e->stacks + i * e->observation_size, e->start_observation,
+           e->observation_size);
+  }
+}
+
+static void step_env(envs *e, size_t i) {
+  nes *n = &e->machines[i];
+  uint8_t *obs = e->obs + i * e->observation_size;
+  uint8_t frame[PPU_HEIGHT * PPU_WIDTH];
+  uint8_t *fb = NULL;
+  if (e->o.observation == ENVS_OBSERVE_PIXELS) {
+    fb = obs;
+  } else if (e->o.observation == ENVS_OBSERVE_GRAYSCALE) {
+    fb = frame;
+  }
+  nes_set_buttons(n, 0, e->actions[i]);
+  for (uint32_t f = 1; f <= e->o.frames_per_step; f++) {
+    nes_run_frame_indexed(n, f == e->o.frames_per_step ? fb : NULL,
+                          PPU_WIDTH);
+  }
+
+  bool done = false;
+  e->rewards[i] = e->o.reward ? e->o.reward(n, i, &done, e->o.ctx) : 0;
+  e->dones[i] = done;
+  if (done) {
+    reset_env(e, i);
+  } else if (e->o.observation == ENVS_OBSERVE_RAM) {
+    memcpy(obs, n->ram, sizeof(n->ram));
+  } else if (e->o.observation == ENVS_OBSERVE_GRAYSCALE) {
+    // the caller's obs may be another buffer each step, so the stack is kept
+    uint8_t *stack = e->stacks + i * e->observation_size;
+    observer_push(&e->observer, stack, frame, PPU_WIDTH);
+    memcpy(obs, stack, e->observation_size);
+  }
+}
+
+static void step_task(void *ctx, size_t i) { step_env(ctx, i); }
+
+static void reset_task(void *ctx, size_t i) { reset_env(ctx, i); }
+
+// A plain copy of the machine in state, sharing the ROM of start
+static void init_machine(nes *n, const nes *start, const nes *state) {
+  nes_init(n);
+  n->cartridge.prg_rom = start->cartridge.prg_rom;
+  n->cartridge.chr_rom = start->cartridge.chr_rom;
+  nes_load_state(n, state);
+}
+
+envs *envs_create(const nes *start, const envs_options *o) {
+  if (o->count == 0 || o->frames_per_step == 0 || o->threads <= 0) {
+    return NULL;
+  }
+  envs *e = aligned_alloc(_Alignof(envs), sizeof(envs));
+  if (!e) {
+    return NULL;
+  }
+  memset(e, 0, sizeof(envs));
+  e->o = *o;
+  switch (o->observation) {
+  case ENVS_OBSERVE_PIXELS:
+    e->observation_size = PPU_WIDTH * PPU_HEIGHT;
+    break;
+  case ENVS_OBSERVE_RAM:
+    e->observation_size = sizeof(start->ram);
+    break;
+  case ENVS_OBSERVE_GRAYSCALE:
+    if (!observer_init(&e->observer, o->width, o->height, o->stack)) {
+      free(e);
+      return NULL;
+    }
+    e->observation_size = observer_size(&e->observer);
+    e->stacks = malloc(o->count * e->observation_size);
+    break;
+  }
+  e->start_observation = malloc(e->observation_size);
+  e->machines = aligned_alloc(NES_CACHE_LINE, o->count * sizeof(nes));
+  uint8_t *frame = malloc(PPU_WIDTH * PPU_HEIGHT);
+  // more threads than machines would idle
+  size_t threads = o->threads;
+  if (o->count < threads) {
+    threads = o->count;
+  }
+  e->pool = pool_create(threads);
+  if (!e->start_observation || !e->machines || !frame || !e->pool ||
+      (o->observation == ENVS_OBSERVE_GRAYSCALE && !e->stacks)) {
+    if (e->pool) {
+      pool_destroy(e->pool);
+    }
+    free(frame);
+    free(e->start_observation);
+    free(e->machines);
+    free(e->stacks);
+    free(e);
+    return NULL;
+  }
+
+  // run the start for a frame to have something to observe
+  nes *first = &e->machines[0];
+  nes_save_state(start, &e->start);
+  init_machine(first, start, &e->start);
+  nes_run_frame_indexed(first, frame, PPU_WIDTH);
+  switch (o->observation) {
+  case ENVS_OBSERVE_PIXELS:
+    memcpy(e->start_observation, frame, e->observation_size);
+    break;
+  case ENVS_OBSERVE_RAM:
+    memcpy(e->start_observation, first->ram, sizeof(first->ram));
+    break;
+  case ENVS_OBSERVE_GRAYSCALE:
+    observer_fill(&e->observer, e->start_observation, frame, PPU_WIDTH);
+    break;
+  }
+  free(frame);
+  nes_save_state(first, &e->start);
+  for (size_t i = 0; i < o->count; i++) {
+    init_machine(&e->machines[i], start, &e->start);
+  }
+
+  return e;
+}
+
+void envs_destroy(envs *e) {
+  pool_destroy(e->pool);
+  free(e->start_observation);
+  free(e->machines);
+  free(e->stacks);
+  free(e);
+}
+
+size_t envs_observation_size(const envs *e) { return e->observation_size; }
+
+void envs_reset(envs *e, uint8_t *obs) {
+  e->obs = obs;
+  pool_run(e->pool, e->o.count, reset_task, e);
+}
+
+void envs_step(envs *e, const uint8_t *actions, uint8_t *obs, float *rewards,
+               bool *dones) {
+  e->actions = actions;
+  e->obs = obs;
+  e->rewards = rewards;
+  e->dones = dones;
+  pool_run(e->pool, e->o.count, step_task, e);
+}
+
+const nes *envs_machine(const envs *e, size_t i) { return &e->machines[i]; }
@@ -0,0 +1,67 @@
+#ifndef ENVS_H
+#define ENVS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nes.h"
+
+// Batched environments for reinforcement learning
+//
+// A batch holds count machines started from the same snapshot. One
+// envs_step() call applies an action to every machine, runs them for
+// frames_per_step frames in parallel and writes all observations into one
+// contiguous array, so bindings cross into C once per batch instead of once
+// per environment.
+//
+// Episodes begin one frame after the start state given to envs_create(), so
+// that the start has a frame to observe. Machines whose episode ends are reset
+// to that snapshot within the same step.
+
+typedef enum EnvsObservation {
+  ENVS_OBSERVE_PIXELS,    // PPU_HEIGHT x PPU_WIDTH palette indexes
+  ENVS_OBSERVE_RAM,       // the 2KB of RAM
+  ENVS_OBSERVE_GRAYSCALE, // stacks of downscaled frames, see observer.h
+} envs_observation;
+
+// Reward for the step just run by machine env, and whether its episode is
+// over. Called from worker threads, concurrently for different envs.
+typedef float (*envs_reward)(const nes *n, size_t env, bool *done, void *ctx);
+
+typedef struct EnvsOptions {
+  size_t count;
+  uint32_t frames_per_step; // the action is held for all of them
+  envs_observation observation;
+  int width, height, stack; // of ENVS_OBSERVE_GRAYSCALE observations
+  int threads;              // including the caller's
+  envs_reward reward;       // optional, without it episodes never end
+  void *ctx;
+} envs_options;
+
+typedef struct Envs envs;
+
+// start must have its ROM loaded; the ROM image must outlive the batch.
+// Returns NULL on failure, if count or frames_per_step is 0, or if threads
+// is not positive.
+envs *envs_create(const nes *start, const envs_options *o);
+
+void envs_destroy(envs *e);
+
+// Bytes per observation, so obs arrays are count times this
+size_t envs_observation_size(const envs *e);
+
+// Reset every machine and write the start observation of each into obs
+void envs_reset(envs *e, uint8_t *obs);
+
+// Hold actions[i] (controller_button bits on port 0) on machine i for a step.
+// Writes its observation into obs, its reward into rewards[i] and whether its
+// episode ended into dones[i]. A machine that is done is reset, and its
+// observation is the start observation of the next episode.
+void envs_step(envs *e, const uint8_t *actions, uint8_t *obs, float *rewards,
+               bool *dones);
+
+// Machine i, e.g. for a reward function that needs more than the observation
+const nes *envs_machine(const envs *e, size_t i);
+
+#endif // ENVS_H
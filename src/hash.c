@@ -0,0 +1,173 @@
+#include "hash.h"
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define P1 0x9E3779B185EBCA87ULL
+#define P2 0xC2B2AE3D27D4EB4FULL
+#define P3 0x165667B19E3779F9ULL
+#define P4 0x85EBCA77C2B2AE63ULL
+#define P5 0x27D4EB2F165667C5ULL
+
+static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+static uint64_t read64(const uint8_t *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static uint32_t read32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static uint64_t round64(uint64_t acc, uint64_t input) {
+  acc += input * P2;
+  acc = rotl(acc, 31);
+  return acc * P1;
+}
+
+static uint64_t merge(uint64_t acc, uint64_t val) {
+  acc ^= round64(0, val);
+  return acc * P1 + P4;
+}
+
+uint64_t hash64(const void *data, size_t len, uint64_t seed) {
+  const uint8_t *p = data;
+  const uint8_t *end = p + len;
+  uint64_t h;
+
+  if (32 <= len) {
+    uint64_t v1 = seed + P1 + P2;
+    uint64_t v2 = seed + P2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - P1;
+    // four independent lanes, so the loop vectorizes and pipelines well
+    for (; p + 32 <= end; p += 32) {
+      v1 = round64(v1, read64(p));
+      v2 = round64(v2, read64(p + 8));
+      v3 = round64(v3, read64(p + 16));
+      v4 = round64(v4, read64(p + 24));
+    }
+    h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+    h = merge(h, v1);
+    h = merge(h, v2);
+    h = merge(h, v3);
+    h = merge(h, v4);
+  } else {
+    h = seed + P5;
+  }
+  h += len;
+
+  for (; p + 8 <= end; p += 8) {
+    h ^= round64(0, read64(p));
+    h = rotl(h, 27) * P1 + P4;
+  }
+  if (p + 4 <= end) {
+    h ^= (uint64_t)read32(p) * P1;
+    h = rotl(h, 23) * P2 + P3;
+    p += 4;
+  }
+  for (; p < end; p++) {
+    h ^= *p * P5;
+    h = rotl(h, 11) * P1;
+  }
+
+  h ^= h >> 33;
+  h *= P2;
+  h ^= h >> 29;
+  h *= P3;
+  h ^= h >> 32;
+  return h;
+}
+
+#define WIDE_LANES 8
+#define WIDE_STRIPE (WIDE_LANES * 8)
+#define WIDE_STRIPES_PER_BLOCK 16
+
+static const uint64_t wide_keys[WIDE_LANES] = {
+    0xBE4BA423396CFEB8ULL, 0x1CAD21F72C81017CULL, 0xDB979083E96DD4DEULL,
+    0x1F67B3B7A4A44072ULL, 0x78E5C0CC4EE679CBULL, 0x2172FFCC7DD05A82ULL,
+    0x8E2443F7744608B8ULL, 0x4C263A81E69035E0ULL,
+};
+
+#ifdef __SSE2__
+// two lanes per register
+static void wide_stripes(uint64_t *acc, const uint8_t **pp, const uint8_t *end) {
+  const uint8_t *p = *pp;
+  __m128i a[4], keys[4];
+  for (int i = 0; i < 4; i++) {
+    a[i] = _mm_loadu_si128((const __m128i *)(acc + i * 2));
+    keys[i] = _mm_loadu_si128((const __m128i *)(wide_keys + i * 2));
+  }
+  const __m128i prime = _mm_set1_epi64x(0x9E3779B1);
+
+  int stripes = 0;
+  for (; p + WIDE_STRIPE <= end; p += WIDE_STRIPE) {
+    for (int i = 0; i < 4; i++) {
+      __m128i d = _mm_loadu_si128((const __m128i *)(p + i * 16));
+      __m128i k = _mm_xor_si128(d, keys[i]);
+      a[i] = _mm_add_epi64(a[i], _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2)));
+      a[i] = _mm_add_epi64(a[i], _mm_mul_epu32(k, _mm_srli_epi64(k, 32)));
+    }
+    if (++stripes == WIDE_STRIPES_PER_BLOCK) {
+      stripes = 0;
+      for (int i = 0; i < 4; i++) {
+        __m128i x = _mm_xor_si128(a[i], _mm_srli_epi64(a[i], 47));
+        __m128i lo = _mm_mul_epu32(x, prime);
+        __m128i hi = _mm_mul_epu32(_mm_srli_epi64(x, 32), prime);
+        a[i] = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+      }
+    }
+  }
+
+  for (int i = 0; i < 4; i++) {
+    _mm_storeu_si128((__m128i *)(acc + i * 2), a[i]);
+  }
+  *pp = p;
+}
+#else
+static void wide_stripes(uint64_t *acc, const uint8_t **pp, const uint8_t *end) {
+  const uint8_t *p = *pp;
+  int stripes = 0;
+  for (; p + WIDE_STRIPE <= end; p += WIDE_STRIPE) {
+    for (int i = 0; i < WIDE_LANES; i++) {
+      uint64_t d = read64(p + i * 8);
+      uint64_t k = d ^ wide_keys[i];
+      acc[i ^ 1] += d;
+      acc[i] += (k & 0xFFFFFFFF) * (k >> 32);
+    }
+    if (++stripes == WIDE_STRIPES_PER_BLOCK) {
+      stripes = 0;
+      for (int i = 0; i < WIDE_LANES; i++) {
+        acc[i] ^= acc[i] >> 47;
+        acc[i] *= 0x9E3779B1;
+      }
+    }
+  }
+  *pp = p;
+}
+#endif
+
+uint64_t hash64_wide(const void *data, size_t len, uint64_t seed) {
+  const uint8_t *p = data;
+  const uint8_t *end = p + len;
+
+  uint64_t acc[WIDE_LANES];
+  for (int i = 0; i < WIDE_LANES; i++) {
+    acc[i] = wide_keys[i] ^ seed;
+  }
+  wide_stripes(acc, &p, end);
+
+  uint64_t h = len * P1 ^ seed;
+  for (int i = 0; i < WIDE_LANES; i++) {
+    h = merge(h, acc[i]);
+  }
+  // the tail, and the final avalanche
+  return hash64(p, end - p, h);
+}
@@ -0,0 +1,16 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 64-bit non-cryptographic hash (XXH64) for ROM, RAM and frame identity
+// https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+uint64_t hash64(const void *data, size_t len, uint64_t seed);
+
+// 64-bit hash for large blocks such as whole machine states. Eight lanes of
+// 32x32->64 multiply-accumulate per 64-byte stripe (after XXH3), which
+// compilers vectorize with SSE2/AVX2. Not compatible with hash64().
+uint64_t hash64_wide(const void *data, size_t len, uint64_t seed);
+
+#endif // HASH_H
@@ -0,0 +1,137 @@
+#include "heatmap.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "bus.h"
+
+#define HEATMAP_TOP 16
+
+void heatmap_attach(nes *n, heatmap *h) {
+  memset(h, 0, sizeof(*h));
+  n->heatmap = h;
+  bus_map_pages(n);
+}
+
+void heatmap_detach(nes *n) {
+  n->heatmap = NULL;
+  bus_map_pages(n);
+}
+
+void heatmap_protect_pages(nes *n) {
+  memset(n->read_pages, 0, sizeof(n->read_pages));
+  memset(n->write_pages, 0, sizeof(n->write_pages));
+}
+
+// log2 scale by bit length, 0 stays black
+static int bits(uint64_t v) { return v ? 64 - __builtin_clzll(v) : 0; }
+
+static uint8_t scale(uint64_t count, int max_bits) {
+  return count ? 32 + 223 * bits(count) / max_bits : 0;
+}
+
+bool heatmap_write_ppm(FILE *f, const heatmap *h) {
+  uint64_t max = 1;
+  for (int i = 0; i < 0x10000; i++) {
+    max = h->reads[i] > max ? h->reads[i] : max;
+    max = h->writes[i] > max ? h->writes[i] : max;
+  }
+  int max_bits = bits(max);
+
+  if (fprintf(f, "P6\n256 256\n255\n") < 0) {
+    return false;
+  }
+  for (int i = 0; i < 0x10000; i++) {
+    uint8_t rgb[3] = {scale(h->writes[i], max_bits),
+                      scale(h->reads[i], max_bits), 0};
+    if (fwrite(rgb, 1, sizeof(rgb), f) != sizeof(rgb)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// https://www.nesdev.org/wiki/PPU_registers
+static const char *const ppu_registers[8] = {
+    "PPUCTRL", "PPUMASK", "PPUSTATUS", "OAMADDR",
+    "OAMDATA", "PPUSCROLL", "PPUADDR", "PPUDATA",
+};
+
+// https://www.nesdev.org/wiki/APU_registers
+static const char *const io_registers[0x20] = {
+    "SQ1_VOL",    "SQ1_SWEEP", "SQ1_LO",    "SQ1_HI",   "SQ2_VOL",
+    "SQ2_SWEEP",  "SQ2_LO",    "SQ2_HI",    "TRI_LINEAR", "$4009",
+    "TRI_LO",     "TRI_HI",    "NOISE_VOL", "$400D",    "NOISE_LO",
+    "NOISE_HI",   "DMC_FREQ",  "DMC_RAW",   "DMC_START", "DMC_LEN",
+    "OAMDMA",     "SND_CHN",   "JOY1",      "JOY2",     "$4018",
+    "$4019",      "$401A",     "$401B",     "$401C",    "$401D",
+    "$401E",      "$401F",
+};
+
+bool heatmap_write_json(FILE *f, const heatmap *h) {
+  fprintf(f, "{\n  \"pages\": [\n");
+  for (int page = 0; page < NES_PAGES; page++) {
+    uint64_t reads = 0, writes = 0;
+    for (int i = page << NES_PAGE_BITS; i < (page + 1) << NES_PAGE_BITS; i++) {
+      reads += h->reads[i];
+      writes += h->writes[i];
+    }
+    fprintf(f,
+            "    {\"addr\": %d, \"size\": %d, \"reads\": %" PRIu64
+            ", \"writes\": %" PRIu64 "}%s\n",
+            page << NES_PAGE_BITS, NES_PAGE_SIZE, reads, writes,
+            page + 1 < NES_PAGES ? "," : "");
+  }
+
+  fprintf(f, "  ],\n  \"io\": [\n");
+  for (int r = 0; r < 8 + 0x20; r++) {
+    uint64_t reads = 0, writes = 0;
+    if (r < 8) {
+      for (int i = 0x2000 + r; i < 0x4000; i += 8) {
+        reads += h->reads[i];
+        writes += h->writes[i];
+      }
+    } else {
+      reads = h->reads[0x4000 + r - 8];
+      writes = h->writes[0x4000 + r - 8];
+    }
+    fprintf(f,
+            "    {\"register\": \"%s\", \"addr\": %d, \"reads\": %" PRIu64 ", "
+            "\"writes\": %" PRIu64 "}%s\n",
+            r < 8 ? ppu_registers[r] : io_registers[r - 8],
+            r < 8 ? 0x2000 + r : 0x4000 + r - 8, reads,
+            writes, r + 1 < 8 + 0x20 ? "," : "");
+  }
+
+  // busiest addresses by selection, HEATMAP_TOP is small
+  int top[HEATMAP_TOP];
+  int count = 0;
+  for (; count < HEATMAP_TOP; count++) {
+    int best = -1;
+    uint64_t best_total = 0;
+    for (int i = 0; i < 0x10000; i++) {
+      uint64_t total = h->reads[i] + h->writes[i];
+      bool taken = false;
+      for (int j = 0; j < count; j++) {
+        taken |= top[j] == i;
+      }
+      if (best_total < total && !taken) {
+        best = i;
+        best_total = total;
+      }
+    }
+    if (best < 0) {
+      break;
+    }
+    top[count] = best;
+  }
+  fprintf(f, "  ],\n  \"top\": [\n");
+  for (int j = 0; j < count; j++) {
+    fprintf(f,
+            "    {\"addr\": %d, \"reads\": %" PRIu64 ", \"writes\": %" PRIu64
+            "}%s\n",
+            top[j], h->reads[top[j]], h->writes[top[j]],
+            j + 1 < count ? "," : "");
+  }
+  return fprintf(f, "  ]\n}\n") >= 0 && !ferror(f);
+}
@@ -0,0 +1,35 @@
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "nes.h"
+
+// Bus access counters, one pair per CPU address, updated by mem_read() and
+// mem_write(). While a heatmap is attached the CPU page table is empty, so
+// every access goes through them.
+
+typedef struct Heatmap {
+  uint64_t reads[0x10000];
+  uint64_t writes[0x10000];
+} heatmap;
+
+// Clear h, owned by the caller, and count the accesses of n into it
+void heatmap_attach(nes *n, heatmap *h);
+
+void heatmap_detach(nes *n);
+
+// Leave every page out of the page table of n
+void heatmap_protect_pages(nes *n);
+
+// 256x256 binary PPM, one pixel per address with rows of 256 addresses.
+// Writes are red and reads green, log-scaled to the busiest address.
+bool heatmap_write_ppm(FILE *f, const heatmap *h);
+
+// Totals per NES_PAGE_SIZE page and per I/O register (PPU registers folded
+// over their mirrors), and the busiest addresses
+bool heatmap_write_json(FILE *f, const heatmap *h);
+
+#endif // HEATMAP_H
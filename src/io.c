@@ -0,0 +1,33 @@
+#include "io.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+
+bool read_full(int fd, void *buf, size_t size) {
+  for (size_t done = 0; done < size;) {
+    ssize_t r = read(fd, (uint8_t *)buf + done, size - done);
+    if (r < 0 && errno == EINTR) {
+      continue;
+    }
+    if (r <= 0) {
+      return false;
+    }
+    done += r;
+  }
+  return true;
+}
+
+bool write_full(int fd, const void *buf, size_t size) {
+  for (size_t done = 0; done < size;) {
+    ssize_t w = write(fd, (const uint8_t *)buf + done, size - done);
+    if (w < 0 && errno == EINTR) {
+      continue;
+    }
+    if (w < 0) {
+      return false;
+    }
+    done += w;
+  }
+  return true;
+}
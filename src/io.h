@@ -0,0 +1,14 @@
+#ifndef IO_H
+#define IO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// read()/write() exactly size bytes, retrying on short transfers and EINTR.
+// read_full returns false on EOF too. A write to a pipe or socket whose
+// reader is gone raises SIGPIPE, which callers that want write_full to fail
+// instead have to ignore.
+bool read_full(int fd, void *buf, size_t size);
+bool write_full(int fd, const void *buf, size_t size);
+
+#endif // IO_H
@@ -0,0 +1,155 @@
+#include "lz.h"
+
+#include <string.h>
+
+#define MIN_MATCH 4
+#define MAX_OFFSET 0xFFFF
+#define HASH_BITS 12
+
+static uint32_t read32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static uint32_t hash(uint32_t v) { return v * 2654435761u >> (32 - HASH_BITS); }
+
+// Write the part of length beyond a full nibble
+static uint8_t *put_length(uint8_t *out, const uint8_t *end, size_t length) {
+  for (length -= 15; 255 <= length; length -= 255) {
+    if (out == end) {
+      return NULL;
+    }
+    *out++ = 255;
+  }
+  if (out == end) {
+    return NULL;
+  }
+  *out++ = length;
+  return out;
+}
+
+static bool get_length(const uint8_t **in, const uint8_t *end,
+                       size_t *length) {
+  uint8_t b;
+  do {
+    if (*in == end) {
+      return false;
+    }
+    b = *(*in)++;
+    *length += b;
+  } while (b == 255);
+  return true;
+}
+
+// A sequence of literals, then a match unless length is 0. Returns NULL if
+// out of room.
+static uint8_t *put_sequence(uint8_t *out, const uint8_t *end,
+                             const uint8_t *literals, size_t count,
+                             size_t offset, size_t length) {
+  if (out == end) {
+    return NULL;
+  }
+  size_t match = length ? length - MIN_MATCH : 0;
+  uint8_t *token = out++;
+  *token = (count < 15 ? count : 15) << 4 | (match < 15 ? match : 15);
+  if (15 <= count && !(out = put_length(out, end, count))) {
+    return NULL;
+  }
+  if ((size_t)(end - out) < count) {
+    return NULL;
+  }
+  memcpy(out, literals, count);
+  out += count;
+  if (length) {
+    if (end - out < 2) {
+      return NULL;
+    }
+    *out++ = offset;
+    *out++ = offset >> 8;
+    if (15 <= match && !(out = put_length(out, end, match))) {
+      return NULL;
+    }
+  }
+  return out;
+}
+
+size_t lz_compress(uint8_t *dst, size_t capacity, const uint8_t *src,
+                   size_t size) {
+  uint32_t table[1 << HASH_BITS] = {0}; // last position of each hash
+  const uint8_t *end = dst + capacity;
+  uint8_t *out = dst;
+  size_t anchor = 0; // first byte not encoded yet
+  size_t i = 0;
+  while (i + MIN_MATCH <= size) {
+    uint32_t h = hash(read32(src + i));
+    size_t candidate = table[h];
+    table[h] = i;
+    if (candidate < i && i - candidate <= MAX_OFFSET &&
+        read32(src + candidate) == read32(src + i)) {
+      size_t length = MIN_MATCH;
+      while (i + length < size && src[candidate + length] == src[i + length]) {
+        length++;
+      }
+      out = put_sequence(out, end, src + anchor, i - anchor, i - candidate,
+                         length);
+      if (!out) {
+        return 0;
+      }
+      i += length;
+      anchor = i;
+    } else {
+      i++;
+    }
+  }
+  out = put_sequence(out, end, src + anchor, size - anchor, 0, 0);
+  return out ? (size_t)(out - dst) : 0;
+}
+
+bool lz_decompress(uint8_t *dst, size_t size, const uint8_t *src,
+                   size_t src_size) {
+  const uint8_t *in = src;
+  const uint8_t *end = src + src_size;
+  size_t o = 0;
+  for (;;) {
+    if (in == end) {
+      return false; // the last sequence is missing
+    }
+    uint8_t token = *in++;
+    size_t count = token >> 4;
+    if (count == 15 && !get_length(&in, end, &count)) {
+      return false;
+    }
+    if ((size_t)(end - in) < count || size - o < count) {
+      return false;
+    }
+    memcpy(dst + o, in, count);
+    in += count;
+    o += count;
+    if (in == end) {
+      return o == size; // the last sequence
+    }
+    if (end - in < 2) {
+      return false;
+    }
+    size_t offset = in[0] | in[1] << 8;
+    in += 2;
+    size_t length = token & 15;
+    if (length == 15 && !get_length(&in, end, &length)) {
+      return false;
+    }
+    length += MIN_MATCH;
+    if (offset == 0 || o < offset || size - o < length) {
+      return false;
+    }
+    if (length <= offset) {
+      memcpy(dst + o, dst + o - offset, length);
+    } else {
+      // overlapping, e.g. a run of zeros with offset 1
+      for (size_t k = 0; k < length; k++) {
+        dst[o + k] = dst[o + k - offset];
+      }
+    }
+    o += length;
+  }
+}
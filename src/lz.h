@@ -0,0 +1,25 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Byte-oriented LZ77 compression for machine states, in the spirit of the LZ4
+// block format: a sequence is a token byte (literal count in the high nibble,
+// match length - 4 in the low one, 15 meaning more length bytes follow), the
+// literals, and a 16-bit little endian match offset. The last sequence has
+// literals only. States are mostly zeros and repeated tables, which a greedy
+// match on a hash of 4 bytes compresses well at memcpy-like decoding speed.
+
+// Compress size bytes of src into dst. Returns the compressed size, or 0 if
+// it would exceed capacity.
+size_t lz_compress(uint8_t *dst, size_t capacity, const uint8_t *src,
+                   size_t size);
+
+// Decompress src into exactly size bytes at dst. Returns false if src is
+// malformed or does not decompress to size bytes; dst is then undefined.
+bool lz_decompress(uint8_t *dst, size_t size, const uint8_t *src,
+                   size_t src_size);
+
+#endif // LZ_H
@@ -1,11 +1,21 @@
 #include "memory_map.h"
 
+#include "heatmap.h"
+
 memory_map current;
 
 void init_memory_map(memory_map mem) { current = mem; }
 
-uint8_t mem_read(nes *n, uint16_t addr) { return current.read(n, addr); }
+uint8_t mem_read(nes *n, uint16_t addr) {
+  if (n->heatmap) {
+    n->heatmap->reads[addr]++;
+  }
+  return current.read(n, addr);
+}
 
 void mem_write(nes *n, uint16_t addr, uint8_t val) {
+  if (n->heatmap) {
+    n->heatmap->writes[addr]++;
+  }
   current.write(n, addr, val);
 }
@@ -0,0 +1,95 @@
+#include "movie.h"
+
+#include <string.h>
+#include <sys/types.h>
+
+static const uint8_t magic[4] = {'X', 'M', 'V', 0x1A};
+
+static uint64_t get_le(const uint8_t *p, int size) {
+  uint64_t v = 0;
+  for (int i = size - 1; 0 <= i; i--) {
+    v = (v << 8) | p[i];
+  }
+  return v;
+}
+
+static void put_le(uint8_t *p, uint64_t v, int size) {
+  for (int i = 0; i < size; i++) {
+    p[i] = v >> (i * 8);
+  }
+}
+
+bool movie_read_header(FILE *f, movie_header *h) {
+  uint8_t b[MOVIE_HEADER_SIZE];
+  if (fread(b, 1, sizeof(b), f) != sizeof(b) || memcmp(b, magic, 4) != 0 ||
+      get_le(b + 4, 2) != MOVIE_VERSION) {
+    return false;
+  }
+  h->ports = b[6];
+  h->start = b[7];
+  h->ram_fill = b[8];
+  h->state_size = get_le(b + 12, 4);
+  h->rom_hash = get_le(b + 16, 8);
+  h->frames = get_le(b + 24, 4);
+  h->checkpoints = get_le(b + 28, 4);
+  return (h->ports == 1 || h->ports == 2) && h->start == MOVIE_START_POWER_ON;
+}
+
+bool movie_write_header(FILE *f, const movie_header *h) {
+  uint8_t b[MOVIE_HEADER_SIZE] = {0};
+  memcpy(b, magic, 4);
+  put_le(b + 4, MOVIE_VERSION, 2);
+  b[6] = h->ports;
+  b[7] = h->start;
+  b[8] = h->ram_fill;
+  put_le(b + 12, h->state_size, 4);
+  put_le(b + 16, h->rom_hash, 8);
+  put_le(b + 24, h->frames, 4);
+  put_le(b + 28, h->checkpoints, 4);
+  return fwrite(b, 1, sizeof(b), f) == sizeof(b);
+}
+
+bool movie_read_frame(FILE *f, const movie_header *h, uint8_t buttons[2]) {
+  buttons[1] = 0;
+  return fread(buttons, 1, h->ports, f) == h->ports;
+}
+
+bool movie_write_frame(FILE *f, const movie_header *h,
+                       const uint8_t buttons[2]) {
+  return fwrite(buttons, 1, h->ports, f) == h->ports;
+}
+
+bool movie_seek_frame(FILE *f, const movie_header *h, uint32_t frame) {
+  return fseeko(f, MOVIE_HEADER_SIZE + (off_t)frame * h->ports, SEEK_SET) ==
+         0;
+}
+
+bool movie_read_checkpoint(FILE *f, const movie_header *h, uint32_t index,
+                           movie_checkpoint *c) {
+  if (h->checkpoints <= index || h->state_size != sizeof(nes)) {
+    return false;
+  }
+  off_t offset = MOVIE_HEADER_SIZE + (off_t)h->frames * h->ports +
+                 (off_t)index * (16 + h->state_size);
+  uint8_t b[16];
+  if (fseeko(f, offset, SEEK_SET) != 0 || fread(b, 1, 16, f) != 16 ||
+      fread(&c->state, 1, sizeof(nes), f) != sizeof(nes)) {
+    return false;
+  }
+  c->frame = get_le(b, 4);
+  c->state_hash = get_le(b + 8, 8);
+  return true;
+}
+
+bool movie_write_checkpoint(FILE *f, const movie_checkpoint *c) {
+  uint8_t b[16] = {0};
+  put_le(b, c->frame, 4);
+  put_le(b + 8, c->state_hash, 8);
+  return fwrite(b, 1, 16, f) == 16 &&
+         fwrite(&c->state, 1, sizeof(nes), f) == sizeof(nes);
+}
+
+void movie_power_on(nes *n, const movie_header *h) {
+  memset(n->ram, h->ram_fill, sizeof(n->ram));
+  nes_power_on(n);
+}
@@ -0,0 +1,81 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "nes.h"
+
+// Input movie
+//
+// A 32-byte header followed by one byte of controller_button bits per port
+// per frame, and optionally by checkpoints. Multi-byte fields are little
+// endian.
+//
+//   0  4  magic "XMV\x1A"
+//   4  2  version
+//   6  1  ports, 1 or 2
+//   7  1  start, movie_start
+//   8  1  RAM fill value at power on
+//   9  3  reserved
+//   12 4  checkpoint state size, sizeof(nes) of the recording build
+//   16 8  cartridge_hash() of the ROM
+//   24 4  frame count
+//   28 4  checkpoint count
+//
+// Each checkpoint is the state after a number of frames:
+//
+//   0  4  frame
+//   4  4  reserved
+//   8  8  nes_state_hash() of the state
+//   16    nes_save_state() of the state, checkpoint state size bytes
+
+#define MOVIE_VERSION 1
+#define MOVIE_HEADER_SIZE 32
+
+typedef enum MovieStart {
+  MOVIE_START_POWER_ON = 0,
+} movie_start;
+
+typedef struct MovieHeader {
+  uint8_t ports;
+  uint8_t start;
+  uint8_t ram_fill;
+  uint32_t state_size;
+  uint64_t rom_hash;
+  uint32_t frames;
+  uint32_t checkpoints;
+} movie_header;
+
+typedef struct MovieCheckpoint {
+  uint32_t frame;
+  uint64_t state_hash;
+  nes state;
+} movie_checkpoint;
+
+bool movie_read_header(FILE *f, movie_header *h);
+
+bool movie_write_header(FILE *f, const movie_header *h);
+
+// Read the buttons of the next frame, one byte per port
+bool movie_read_frame(FILE *f, const movie_header *h, uint8_t buttons[2]);
+
+bool movie_write_frame(FILE *f, const movie_header *h,
+                       const uint8_t buttons[2]);
+
+// Seek to the inputs of frame (0 is the first frame)
+bool movie_seek_frame(FILE *f, const movie_header *h, uint32_t frame);
+
+// Read checkpoint index. The state is only read if it was recorded by a build
+// with the same state size.
+bool movie_read_checkpoint(FILE *f, const movie_header *h, uint32_t index,
+                           movie_checkpoint *c);
+
+// Append a checkpoint after the last frame or checkpoint written
+bool movie_write_checkpoint(FILE *f, const movie_checkpoint *c);
+
+// Bring n into the power-on state recorded in h. The ROM must be loaded.
+void movie_power_on(nes *n, const movie_header *h);
+
+#endif // MOVIE_H
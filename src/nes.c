@@ -1,5 +1,132 @@
 #include "nes.h"
 
-#include <stdlib.h>
+#include <string.h>
 
-void nes_init(nes *n) {}
+#include "bus.h"
+#include "cpu_step.h"
+#include "hash.h"
+#include "memory_map.h"
+#include "ppu_step.h"
+
+void nes_init(nes *n) {
+  memset(n, 0, sizeof(*n));
+  init_memory_map((memory_map){bus_read, bus_write});
+  bus_map_pages(n);
+}
+
+bool nes_load_rom(nes *n, const uint8_t *rom, size_t size) {
+  bool ok = cartridge_load(&n->cartridge, rom, size);
+  bus_map_pages(n);
+  return ok;
+}
+
+void nes_power_on(nes *n) {
+  ppu_power_on(n);
+  cpu_power_on(n);
+  cpu_reset(n);
+}
+
+void nes_set_buttons(nes *n, int port, uint8_t buttons) {
+  n->controllers[port].buttons = buttons;
+}
+
+void nes_save_state(const nes *n, nes *state) {
+  memcpy(state, n, sizeof(nes));
+  state->cartridge.prg_rom = NULL;
+  state->cartridge.chr_rom = NULL;
+  if (n->cartridge.battery_ram) {
+    memcpy(state->cartridge.prg_ram, n->cartridge.battery_ram,
+           sizeof(state->cartridge.prg_ram));
+    state->cartridge.battery_ram = NULL;
+  }
+  state->ppu.fb_rgb = NULL;
+  state->ppu.fb_index = NULL;
+  state->ppu.pitch = 0;
+  state->debugger = NULL;
+  state->debug_stop = false;
+  state->cdl = NULL;
+  state->heatmap = NULL;
+  state->render_thread = NULL;
+  memset(state->read_pages, 0, sizeof(state->read_pages));
+  memset(state->write_pages, 0, sizeof(state->write_pages));
+}
+
+void nes_load_state(nes *n, const nes *state) {
+  const uint8_t *prg_rom = n->cartridge.prg_rom;
+  const uint8_t *chr_rom = n->cartridge.chr_rom;
+  uint8_t *battery_ram = n->cartridge.battery_ram;
+  struct Debugger *d = n->debugger;
+  bool debug_stop = n->debug_stop;
+  struct CDL *c = n->cdl;
+  struct Heatmap *h = n->heatmap;
+  struct RenderThread *r = n->render_thread;
+  memcpy(n, state, sizeof(nes));
+  n->cartridge.prg_rom = prg_rom;
+  n->cartridge.chr_rom = chr_rom;
+  n->cartridge.battery_ram = battery_ram;
+  if (battery_ram) {
+    memcpy(battery_ram, state->cartridge.prg_ram,
+           sizeof(state->cartridge.prg_ram));
+  }
+  n->debugger = d;
+  n->debug_stop = debug_stop;
+  n->cdl = c;
+  n->heatmap = h;
+  n->render_thread = r;
+  bus_map_pages(n);
+}
+
+uint64_t nes_state_hash(const nes *state) {
+  return hash64_wide(state, sizeof(nes), 0);
+}
+
+void nes_tick(nes *n) {
+  // PPU runs 3 dots per CPU cycle on NTSC
+  ppu_step(n);
+  ppu_step(n);
+  ppu_step(n);
+}
+
+static nes_frame run_frame(nes *n) {
+  uintmax_t cycles = n->cpu.cycles;
+  uintmax_t frame = n->ppu.frame;
+  n->debug_stop = false;
+  while (n->ppu.frame == frame && !n->debug_stop) {
+    cpu_step(n);
+  }
+  n->ppu.fb_rgb = NULL;
+  n->ppu.fb_index = NULL;
+  // a hit in the instruction that ended the frame does not stop it, as the
+  // next run would resume in the next frame
+  bool stopped = n->debug_stop && n->ppu.frame == frame;
+  return (nes_frame){n->cpu.cycles - cycles, n->ppu.frame, stopped};
+}
+
+nes_frame nes_run_frame(nes *n, uint32_t *fb, size_t pitch) {
+  n->ppu.fb_rgb = fb;
+  n->ppu.fb_index = NULL;
+  n->ppu.pitch = pitch;
+  return run_frame(n);
+}
+
+nes_frame nes_run_frame_indexed(nes *n, uint8_t *fb, size_t pitch) {
+  n->ppu.fb_rgb = NULL;
+  n->ppu.fb_index = fb;
+  n->ppu.pitch = pitch;
+  return run_frame(n);
+}
+
+void nes_irq_assert(nes *n, interrupt source) {
+  n->interrupt |= source & INTERRUPT_IRQ;
+}
+
+void nes_irq_release(nes *n, interrupt source) {
+  n->interrupt &= ~(source & INTERRUPT_IRQ);
+}
+
+void nes_nmi_set_line(nes *n, bool asserted) {
+  if (asserted && !n->nmi_line) {
+    n->interrupt |= INTERRUPT_NMI;
+  }
+  n->nmi_line = asserted;
+}
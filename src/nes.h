@@ -1,21 +1,124 @@
 #ifndef NES_H
 #define NES_H
 
-#include "cpu.h"
+#include <stddef.h>
 
+#include "cartridge.h"
+#include "controller.h"
+#include "cpu.h"
+#include "ppu.h"
 
+// https://www.nesdev.org/wiki/CPU_interrupts
+//
+// IRQ is level-triggered and wired-OR from several sources, so each source
+// owns one bit and the line is asserted while any of them is set.
+// NMI is edge-triggered, so its bit is a latch set on the rising edge of the
+// line and cleared when the CPU services it.
 typedef enum Interrupt {
-  INTERRUPT_NONE,
-  INTERRUPT_NMI,
-  INTERRUPT_IRQ,
+  INTERRUPT_IRQ_APU_FRAME = 1 << 0,
+  INTERRUPT_IRQ_DMC = 1 << 1,
+  INTERRUPT_IRQ_MAPPER = 1 << 2,
+  INTERRUPT_IRQ = INTERRUPT_IRQ_APU_FRAME | INTERRUPT_IRQ_DMC |
+                  INTERRUPT_IRQ_MAPPER,
+  INTERRUPT_NMI = 1 << 7,
 } interrupt;
 
+// The CPU address space is split into 2KB pages. A page points to memory the
+// CPU accesses directly, or is NULL to go through the bus (I/O registers).
+#define NES_PAGE_BITS 11
+#define NES_PAGE_SIZE (1 << NES_PAGE_BITS)
+#define NES_PAGES (0x10000 >> NES_PAGE_BITS)
+
+#define NES_CACHE_LINE 64
+
+// The whole mutable state of a console in one allocation. Fields touched on
+// every instruction come first, bulk memories after them, and state only
+// touched on rare events last.
 typedef struct NES {
-  cpu cpu;
+  _Alignas(NES_CACHE_LINE) cpu cpu;
+
+  // pending interrupts, non-zero if anything is pending
+  uint8_t interrupt;
+  // current level of the NMI line
+  bool nmi_line;
+  // CPU cycles to be stalled by OAM DMA
+  uint16_t cpu_stall;
+
+  controller controllers[2];
 
-  interrupt interrupt;
+  // built by nes_load_rom() and nes_load_state(), see NES_PAGE_BITS
+  const uint8_t *read_pages[NES_PAGES];
+  uint8_t *write_pages[NES_PAGES];
+
+  _Alignas(NES_CACHE_LINE) uint8_t ram[0x800];
+  _Alignas(NES_CACHE_LINE) ppu ppu;
+  _Alignas(NES_CACHE_LINE) cartridge cartridge;
+
+  // optional, see debugger.h, cdl.h, heatmap.h and render_thread.h
+  struct Debugger *debugger;
+  // set by a debugger hit to stop the running frame, not part of the state
+  bool debug_stop;
+  struct CDL *cdl;
+  struct Heatmap *heatmap;
+  struct RenderThread *render_thread;
 } nes;
 
+_Static_assert(offsetof(nes, cpu_stall) < NES_CACHE_LINE,
+               "CPU registers and interrupts share the first cache line");
+_Static_assert(offsetof(nes, ram) <= 9 * NES_CACHE_LINE,
+               "hot state fits in 9 cache lines");
+
+typedef struct NESFrame {
+  // CPU cycles executed in the frame
+  uintmax_t cycles;
+  // frame number, see ppu.frame
+  uintmax_t frame;
+  // a debugger hit stopped the frame early, running again resumes it. Hits
+  // in the instruction ending the frame do not stop it.
+  bool stopped;
+} nes_frame;
+
+// n holds the whole machine, nothing is allocated by this or any later call.
+// A heap-allocated nes must be aligned to NES_CACHE_LINE (aligned_alloc).
 void nes_init(nes *n);
 
+// Insert an iNES image, which must outlive n
+bool nes_load_rom(nes *n, const uint8_t *rom, size_t size);
+
+void nes_power_on(nes *n);
+
+// Set the controller_button bits pressed on port 0 ($4016) or 1 ($4017)
+void nes_set_buttons(nes *n, int port, uint8_t buttons);
+
+// Copy the machine state of n into state without references to the ROM image,
+// frame buffers or instrumentation, so it can be compared, hashed and stored
+// as bytes. A state can be loaded into any nes with the same ROM, built from
+// the same sources.
+void nes_save_state(const nes *n, nes *state);
+
+// Load state, keeping the ROM image and instrumentation of n. Copying a nes
+// other than through nes_save_state()/nes_load_state() leaves its pages
+// pointing to the source.
+void nes_load_state(nes *n, const nes *state);
+
+// Hash of a state saved by nes_save_state()
+uint64_t nes_state_hash(const nes *state);
+
+// Advance components other than the CPU by one CPU cycle
+void nes_tick(nes *n);
+
+// Run until the start of the next vertical blank, rendering the frame into
+// fb as 0x00RRGGBB with rows pitch pixels apart. fb is only used during the
+// call. If fb is NULL, the frame is emulated without rendering pixels.
+nes_frame nes_run_frame(nes *n, uint32_t *fb, size_t pitch);
+
+// Same as nes_run_frame(), but renders 6-bit palette indexes
+nes_frame nes_run_frame_indexed(nes *n, uint8_t *fb, size_t pitch);
+
+void nes_irq_assert(nes *n, interrupt source);
+
+void nes_irq_release(nes *n, interrupt source);
+
+void nes_nmi_set_line(nes *n, bool asserted);
+
 #endif // NES_H
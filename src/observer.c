@@ -0,0 +1,185 @@
+#include "observer.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define OBSERVER_X86
+#endif
+
+// A kernel adds the luminance of a row of PPU_WIDTH palette indexes (the low
+// 6 bits of each byte) to acc
+typedef void (*kernel)(uint16_t *acc, const uint8_t *row, const uint8_t *gray);
+
+static void accumulate_scalar(uint16_t *acc, const uint8_t *row,
+                              const uint8_t *gray) {
+  for (int x = 0; x < PPU_WIDTH; x++) {
+    acc[x] += gray[row[x] & 0x3F];
+  }
+}
+
+#ifdef OBSERVER_X86
+// The 64 entry table is four 16 byte shuffles. For the quarter k, index ^ k*16
+// is the position within it, or at least 16 otherwise, which the saturating
+// add of 0x70 turns into a shuffle index with the high bit set, selecting 0.
+__attribute__((target("ssse3"))) static void
+accumulate_ssse3(uint16_t *acc, const uint8_t *row, const uint8_t *gray) {
+  __m128i tables[4];
+  for (int k = 0; k < 4; k++) {
+    tables[k] = _mm_loadu_si128((const __m128i *)(gray + k * 16));
+  }
+  const __m128i low = _mm_set1_epi8(0x3F);
+  const __m128i bias = _mm_set1_epi8(0x70);
+  const __m128i zero = _mm_setzero_si128();
+  for (int x = 0; x < PPU_WIDTH; x += 16) {
+    __m128i index = _mm_and_si128(_mm_loadu_si128((const __m128i *)(row + x)),
+                                  low);
+    __m128i g = zero;
+    for (int k = 0; k < 4; k++) {
+      __m128i i = _mm_xor_si128(index, _mm_set1_epi8((char)(k * 16)));
+      g = _mm_or_si128(g, _mm_shuffle_epi8(tables[k], _mm_adds_epu8(i, bias)));
+    }
+    __m128i *a = (__m128i *)(acc + x);
+    _mm_storeu_si128(a, _mm_add_epi16(_mm_loadu_si128(a),
+                                      _mm_unpacklo_epi8(g, zero)));
+    _mm_storeu_si128(a + 1, _mm_add_epi16(_mm_loadu_si128(a + 1),
+                                          _mm_unpackhi_epi8(g, zero)));
+  }
+}
+
+__attribute__((target("avx2"))) static void
+accumulate_avx2(uint16_t *acc, const uint8_t *row, const uint8_t *gray) {
+  __m256i tables[4];
+  for (int k = 0; k < 4; k++) {
+    tables[k] = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)(gray + k * 16)));
+  }
+  const __m256i low = _mm256_set1_epi8(0x3F);
+  const __m256i bias = _mm256_set1_epi8(0x70);
+  for (int x = 0; x < PPU_WIDTH; x += 32) {
+    __m256i index = _mm256_and_si256(
+        _mm256_loadu_si256((const __m256i *)(row + x)), low);
+    __m256i g = _mm256_setzero_si256();
+    for (int k = 0; k < 4; k++) {
+      __m256i i = _mm256_xor_si256(index, _mm256_set1_epi8((char)(k * 16)));
+      g = _mm256_or_si256(
+          g, _mm256_shuffle_epi8(tables[k], _mm256_adds_epu8(i, bias)));
+    }
+    __m256i *a = (__m256i *)(acc + x);
+    __m256i first = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(g));
+    __m256i second = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(g, 1));
+    _mm256_storeu_si256(a, _mm256_add_epi16(_mm256_loadu_si256(a), first));
+    _mm256_storeu_si256(a + 1,
+                        _mm256_add_epi16(_mm256_loadu_si256(a + 1), second));
+  }
+}
+#endif
+
+static kernel accumulate;
+static pthread_once_t accumulate_once = PTHREAD_ONCE_INIT;
+
+static bool use(const char *isa) {
+  if (strcmp(isa, "scalar") == 0) {
+    accumulate = accumulate_scalar;
+    return true;
+  }
+#ifdef OBSERVER_X86
+  if (strcmp(isa, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+    accumulate = accumulate_avx2;
+    return true;
+  }
+  if (strcmp(isa, "ssse3") == 0 && __builtin_cpu_supports("ssse3")) {
+    accumulate = accumulate_ssse3;
+    return true;
+  }
+#endif
+  return false;
+}
+
+static void use_best(void) {
+  if (!use("avx2") && !use("ssse3")) {
+    use("scalar");
+  }
+}
+
+bool observer_select(const char *isa) {
+  // the default is set first, so that it never replaces the kernel selected
+  pthread_once(&accumulate_once, use_best);
+  return use(isa);
+}
+
+bool observer_init(observer *o, int width, int height, int stack) {
+  if (width <= 0 || PPU_WIDTH < width || height <= 0 || PPU_HEIGHT < height ||
+      stack <= 0) {
+    return false;
+  }
+  o->width = width;
+  o->height = height;
+  o->stack = stack;
+  // ITU-R BT.601 luma
+  for (int i = 0; i < 64; i++) {
+    uint32_t rgb = ppu_palette_rgb[i];
+    uint32_t r = rgb >> 16 & 0xFF, g = rgb >> 8 & 0xFF, b = rgb & 0xFF;
+    o->gray[i] = (299 * r + 587 * g + 114 * b + 500) / 1000;
+  }
+  for (int x = 0; x <= width; x++) {
+    o->left[x] = x * PPU_WIDTH / width;
+  }
+  for (int y = 0; y <= height; y++) {
+    o->top[y] = y * PPU_HEIGHT / height;
+  }
+  o->box_width = PPU_WIDTH / width;
+  o->box_height = PPU_HEIGHT / height;
+  for (int i = 0; i < 2; i++) {
+    for (int j = 0; j < 2; j++) {
+      uint64_t area = (uint64_t)(o->box_height + i) * (o->box_width + j);
+      o->reciprocals[i][j] = (1ULL << 40) / area + 1;
+    }
+  }
+  return true;
+}
+
+size_t observer_size(const observer *o) {
+  return (size_t)o->stack * o->height * o->width;
+}
+
+void observer_downscale(const observer *o, uint8_t *dst, const uint8_t *frame,
+                        size_t pitch) {
+  pthread_once(&accumulate_once, use_best);
+  // column sums of a band of rows fit: 255 * PPU_HEIGHT < 65536
+  uint16_t sums[PPU_WIDTH];
+  for (int y = 0; y < o->height; y++) {
+    memset(sums, 0, sizeof(sums));
+    for (int row = o->top[y]; row < o->top[y + 1]; row++) {
+      accumulate(sums, frame + row * pitch, o->gray);
+    }
+    int rows = o->top[y + 1] - o->top[y];
+    const uint64_t *reciprocals = o->reciprocals[rows - o->box_height];
+    for (int x = 0; x < o->width; x++) {
+      int columns = o->left[x + 1] - o->left[x];
+      uint64_t sum = (uint64_t)rows * columns / 2; // to round to nearest
+      for (int column = o->left[x]; column < o->left[x + 1]; column++) {
+        sum += sums[column];
+      }
+      dst[y * o->width + x] =
+          sum * reciprocals[columns - o->box_width] >> 40;
+    }
+  }
+}
+
+void observer_push(const observer *o, uint8_t *out, const uint8_t *frame,
+                   size_t pitch) {
+  size_t size = (size_t)o->height * o->width;
+  memmove(out, out + size, observer_size(o) - size);
+  observer_downscale(o, out + observer_size(o) - size, frame, pitch);
+}
+
+void observer_fill(const observer *o, uint8_t *out, const uint8_t *frame,
+                   size_t pitch) {
+  size_t size = (size_t)o->height * o->width;
+  observer_downscale(o, out, frame, pitch);
+  for (int i = 1; i < o->stack; i++) {
+    memcpy(out + i * size, out, size);
+  }
+}
@@ -0,0 +1,55 @@
+#ifndef OBSERVER_H
+#define OBSERVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ppu.h"
+
+// Observation preprocessing for agents: frames of palette indexes, as
+// rendered by nes_run_frame_indexed(), are turned into small grayscale images
+// and kept as a stack of the last few frames, without going through RGB.
+//
+// Every output pixel is the rounded mean luminance of a box of source pixels.
+// Box edges are at multiples of PPU_WIDTH / width and PPU_HEIGHT / height
+// rounded down, so sizes need not divide the frame. Palette lookups and the
+// vertical box sums use SSSE3 or AVX2 when the CPU has them, with output
+// identical to the scalar path.
+
+typedef struct Observer {
+  int width, height, stack;
+  uint8_t gray[64];               // luminance per palette index
+  uint16_t left[PPU_WIDTH + 1];   // source columns of output column x are
+  uint16_t top[PPU_HEIGHT + 1];   // [left[x], left[x + 1]), same for rows
+  // Boxes are box_width or box_width + 1 columns wide, and the same for rows.
+  // Means are taken by multiplying with 2^40 / area, exact for these sums.
+  int box_width, box_height;
+  uint64_t reciprocals[2][2]; // by extra row and extra column
+} observer;
+
+// Set up width x height observations (at most PPU_WIDTH x PPU_HEIGHT) in
+// stacks of stack frames. Returns false if a size is out of range.
+bool observer_init(observer *o, int width, int height, int stack);
+
+// Bytes of a stack: stack x height x width, oldest frame first
+size_t observer_size(const observer *o);
+
+// Downscale frame (pitch in pixels) into height x width pixels at dst
+void observer_downscale(const observer *o, uint8_t *dst, const uint8_t *frame,
+                        size_t pitch);
+
+// Move the frames of the stack at out one slot towards the front, dropping the
+// oldest, and downscale frame into the last slot
+void observer_push(const observer *o, uint8_t *out, const uint8_t *frame,
+                   size_t pitch);
+
+// Start a stack at out with frame in every slot
+void observer_fill(const observer *o, uint8_t *out, const uint8_t *frame,
+                   size_t pitch);
+
+// Use the kernels for isa: "avx2", "ssse3" or "scalar". Returns false if the
+// CPU lacks it. By default the best one available is used.
+bool observer_select(const char *isa);
+
+#endif // OBSERVER_H
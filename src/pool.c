@@ -0,0 +1,108 @@
+#include "pool.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+struct Pool {
+  // batch in progress
+  pool_task task;
+  void *ctx;
+  size_t count;
+  atomic_size_t cursor;
+
+  pthread_mutex_t lock;
+  pthread_cond_t started;  // to the workers
+  pthread_cond_t finished; // to the caller
+  uint64_t batch;
+  int working; // workers not done with the batch
+  bool closing;
+  pthread_t *workers;
+  int worker_count;
+};
+
+static void run_items(pool *p) {
+  size_t i;
+  while ((i = atomic_fetch_add(&p->cursor, 1)) < p->count) {
+    p->task(p->ctx, i);
+  }
+}
+
+static void *worker_main(void *arg) {
+  pool *p = arg;
+  uint64_t batch = 0;
+  pthread_mutex_lock(&p->lock);
+  for (;;) {
+    while (p->batch == batch && !p->closing) {
+      pthread_cond_wait(&p->started, &p->lock);
+    }
+    if (p->closing) {
+      break;
+    }
+    batch = p->batch;
+    pthread_mutex_unlock(&p->lock);
+    run_items(p);
+    pthread_mutex_lock(&p->lock);
+    if (--p->working == 0) {
+      pthread_cond_signal(&p->finished);
+    }
+  }
+  pthread_mutex_unlock(&p->lock);
+  return NULL;
+}
+
+pool *pool_create(int threads) {
+  pool *p = calloc(1, sizeof(pool));
+  int workers = threads > 1 ? threads - 1 : 0;
+  if (!p || (workers && !(p->workers = calloc(workers, sizeof(pthread_t))))) {
+    free(p);
+    return NULL;
+  }
+  pthread_mutex_init(&p->lock, NULL);
+  pthread_cond_init(&p->started, NULL);
+  pthread_cond_init(&p->finished, NULL);
+  // fewer workers than asked for still run every batch
+  while (p->worker_count < workers &&
+         pthread_create(&p->workers[p->worker_count], NULL, worker_main, p) ==
+             0) {
+    p->worker_count++;
+  }
+  return p;
+}
+
+void pool_destroy(pool *p) {
+  pthread_mutex_lock(&p->lock);
+  p->closing = true;
+  pthread_cond_broadcast(&p->started);
+  pthread_mutex_unlock(&p->lock);
+  for (int i = 0; i < p->worker_count; i++) {
+    pthread_join(p->workers[i], NULL);
+  }
+  pthread_mutex_destroy(&p->lock);
+  pthread_cond_destroy(&p->started);
+  pthread_cond_destroy(&p->finished);
+  free(p->workers);
+  free(p);
+}
+
+void pool_run(pool *p, size_t count, pool_task task, void *ctx) {
+  p->task = task;
+  p->ctx = ctx;
+  p->count = count;
+  atomic_store(&p->cursor, 0);
+  pthread_mutex_lock(&p->lock);
+  p->batch++;
+  p->working = p->worker_count;
+  pthread_cond_broadcast(&p->started);
+  pthread_mutex_unlock(&p->lock);
+
+  run_items(p);
+
+  pthread_mutex_lock(&p->lock);
+  while (p->working) {
+    pthread_cond_wait(&p->finished, &p->lock);
+  }
+  pthread_mutex_unlock(&p->lock);
+}
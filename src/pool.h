@@ -0,0 +1,22 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+// Persistent worker threads for batches of independent items. The calling
+// thread takes items too, so a pool of 1 thread runs everything inline.
+
+typedef void (*pool_task)(void *ctx, size_t item);
+
+typedef struct Pool pool;
+
+// threads includes the caller's. Returns NULL on failure.
+pool *pool_create(int threads);
+
+void pool_destroy(pool *p);
+
+// Run task(ctx, i) for every i < count and return once all are done. Items are
+// handed out in order from a shared cursor. One batch runs at a time.
+void pool_run(pool *p, size_t count, pool_task task, void *ctx);
+
+#endif // POOL_H
@@ -0,0 +1,60 @@
+#ifndef PPU_H
+#define PPU_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PPU_WIDTH 256
+#define PPU_HEIGHT 240
+
+typedef struct PPU {
+  // https://www.nesdev.org/wiki/PPU_registers
+  uint8_t ctrl;   // $2000
+  uint8_t mask;   // $2001
+  uint8_t status; // $2002
+  uint8_t oam_addr;
+  uint8_t data_buffer; // $2007 read buffer
+  uint8_t bus;         // last value written to a register
+
+  // https://www.nesdev.org/wiki/PPU_scrolling
+  uint16_t v, t; // current/temporary VRAM address
+  uint8_t x;     // fine X scroll
+  bool w;        // write toggle
+
+  // https://www.nesdev.org/wiki/PPU_rendering
+  uint16_t scanline; // 0-261, 261 is the pre-render line
+  uint16_t dot;      // 0-340
+  // frames since power on, incremented at the start of vertical blank
+  uintmax_t frame;
+
+  // background fetch latches and pixel pipeline, 4 bits (palette, pattern)
+  // per pixel for the current and the next tile
+  uint8_t nametable_latch, attribute_latch, pattern_low_latch,
+      pattern_high_latch;
+  uint64_t tile_data;
+
+  // sprites on the current scanline, 4 bits per pixel as tile_data
+  uint8_t sprite_count;
+  uint32_t sprite_patterns[8];
+  uint8_t sprite_x[8];
+  uint8_t sprite_priorities[8];
+  uint8_t sprite_indexes[8];
+
+  // Frame output, owned by the caller for the duration of a frame.
+  // Either may be NULL; nothing is written if both are.
+  uint32_t *fb_rgb; // 0x00RRGGBB
+  uint8_t *fb_index; // palette index
+  size_t pitch;     // distance between rows in pixels
+
+  // memories last, so the fields above share few cache lines
+  uint8_t sprite_line[PPU_WIDTH]; // see sprite_line.h
+  uint8_t palette[0x20];
+  uint8_t oam[0x100];
+  uint8_t nametable[0x800];
+} ppu;
+
+// https://www.nesdev.org/wiki/PPU_palettes
+extern const uint32_t ppu_palette_rgb[64];
+
+#endif // PPU_H
@@ -0,0 +1,502 @@
+#include "ppu_step.h"
+
+#include "sprite_line.h"
+
+// PPUCTRL
+#define PPU_CTRL_NAMETABLE 0x03
+#define PPU_CTRL_INCREMENT 0x04
+#define PPU_CTRL_SPRITE_TABLE 0x08
+#define PPU_CTRL_BACKGROUND_TABLE 0x10
+#define PPU_CTRL_SPRITE_SIZE 0x20
+#define PPU_CTRL_NMI 0x80
+
+// PPUMASK
+#define PPU_MASK_GRAYSCALE 0x01
+#define PPU_MASK_BACKGROUND_LEFT 0x02
+#define PPU_MASK_SPRITES_LEFT 0x04
+#define PPU_MASK_BACKGROUND 0x08
+#define PPU_MASK_SPRITES 0x10
+
+// PPUSTATUS
+#define PPU_STATUS_OVERFLOW 0x20
+#define PPU_STATUS_SPRITE_ZERO 0x40
+#define PPU_STATUS_VBLANK 0x80
+
+// clang-format off
+const uint32_t ppu_palette_rgb[64] = {
+  0x666666, 0x002A88, 0x1412A7, 0x3B00A4, 0x5C007E, 0x6E0040, 0x6C0600, 0x561D00,
+  0x333500, 0x0B4800, 0x005200, 0x004F08, 0x00404D, 0x000000, 0x000000, 0x000000,
+  0xADADAD, 0x155FD9, 0x4240FF, 0x7527FE, 0xA01ACC, 0xB71E7B, 0xB53120, 0x994E00,
+  0x6B6D00, 0x388700, 0x0C9300, 0x008F32, 0x007C8D, 0x000000, 0x000000, 0x000000,
+  0xFFFEFF, 0x64B0FF, 0x9290FF, 0xC676FF, 0xF36AFF, 0xFE6ECC, 0xFE8170, 0xEA9E22,
+  0xBCBE00, 0x88D800, 0x5CE430, 0x45E082, 0x48CDDE, 0x4F4F4F, 0x000000, 0x000000,
+  0xFFFEFF, 0xC0DFFF, 0xD3D2FF, 0xE8C8FF, 0xFBC2FF, 0xFEC4EA, 0xFECCC5, 0xF7D8A5,
+  0xE4E594, 0xCFEF96, 0xBDF4AB, 0xB3F3CC, 0xB5EBF2, 0xB8B8B8, 0x000000, 0x000000,
+};
+// clang-format on
+
+void ppu_power_on(nes *n) {
+  // https://www.nesdev.org/wiki/PPU_power_up_state
+  n->ppu.ctrl = 0;
+  n->ppu.mask = 0;
+  n->ppu.status = 0;
+  n->ppu.oam_addr = 0;
+  n->ppu.w = false;
+  n->ppu.t = 0;
+  n->ppu.data_buffer = 0;
+  n->ppu.scanline = 0;
+  n->ppu.dot = 0;
+}
+
+static void update_nmi(nes *n) {
+  nes_nmi_set_line(n, (n->ppu.status & PPU_STATUS_VBLANK) &&
+                          (n->ppu.ctrl & PPU_CTRL_NMI));
+}
+
+// PPU memory map
+// https://www.nesdev.org/wiki/PPU_memory_map
+
+static uint16_t nametable_offset(nes *n, uint16_t addr) {
+  static const uint8_t tables[4][4] = {
+      [MIRRORING_HORIZONTAL] = {0, 0, 1, 1},
+      [MIRRORING_VERTICAL] = {0, 1, 0, 1},
+      [MIRRORING_SINGLE_SCREEN_0] = {0, 0, 0, 0},
+      [MIRRORING_SINGLE_SCREEN_1] = {1, 1, 1, 1},
+  };
+  uint16_t a = addr & 0x0FFF;
+  return tables[n->cartridge.mirroring][a >> 10] * 0x400 | (a & 0x3FF);
+}
+
+static uint8_t palette_offset(uint16_t addr) {
+  uint8_t a = addr & 0x1F;
+  // $3F10/$3F14/$3F18/$3F1C mirror $3F00/$3F04/$3F08/$3F0C
+  return (a & 0x13) == 0x10 ? a & 0x0F : a;
+}
+
+static uint8_t ppu_read(nes *n, uint16_t addr) {
+  addr &= 0x3FFF;
+  if (addr < 0x2000) {
+    return cartridge_read_chr(&n->cartridge, addr);
+  }
+  if (addr < 0x3F00) {
+    return n->ppu.nametable[nametable_offset(n, addr)];
+  }
+  return n->ppu.palette[palette_offset(addr)];
+}
+
+static void ppu_write(nes *n, uint16_t addr, uint8_t val) {
+  addr &= 0x3FFF;
+  if (addr < 0x2000) {
+    cartridge_write_chr(&n->cartridge, addr, val);
+  } else if (addr < 0x3F00) {
+    n->ppu.nametable[nametable_offset(n, addr)] = val;
+  } else {
+    n->ppu.palette[palette_offset(addr)] = val;
+  }
+}
+
+// Registers
+// https://www.nesdev.org/wiki/PPU_registers
+
+uint8_t ppu_read_open_bus(nes *n, uint16_t addr) {
+  (void)addr;
+  return n->ppu.bus;
+}
+
+uint8_t ppu_read_status(nes *n, uint16_t addr) {
+  ppu *p = &n->ppu;
+  uint8_t result = ppu_peek_status(n, addr);
+  p->status &= ~PPU_STATUS_VBLANK;
+  p->w = false;
+  update_nmi(n);
+  return result;
+}
+
+uint8_t ppu_read_oam_data(nes *n, uint16_t addr) {
+  (void)addr;
+  return n->ppu.oam[n->ppu.oam_addr];
+}
+
+uint8_t ppu_read_data(nes *n, uint16_t addr) {
+  (void)addr;
+  ppu *p = &n->ppu;
+  uint8_t result = ppu_read(n, p->v);
+  if ((p->v & 0x3FFF) < 0x3F00) {
+    uint8_t buffered = p->data_buffer;
+    p->data_buffer = result;
+    result = buffered;
+  } else {
+    p->data_buffer = ppu_read(n, p->v - 0x1000);
+  }
+  p->v += (p->ctrl & PPU_CTRL_INCREMENT) ? 32 : 1;
+  return result;
+}
+
+uint8_t ppu_peek_status(const nes *n, uint16_t addr) {
+  (void)addr;
+  return (n->ppu.status & 0xE0) | (n->ppu.bus & 0x1F);
+}
+
+uint8_t ppu_peek_data(const nes *n, uint16_t addr) {
+  (void)addr;
+  const ppu *p = &n->ppu;
+  if ((p->v & 0x3FFF) < 0x3F00) {
+    return p->data_buffer;
+  }
+  return p->palette[palette_offset(p->v)];
+}
+
+void ppu_write_open_bus(nes *n, uint16_t addr, uint8_t val) {
+  (void)addr;
+  n->ppu.bus = val;
+}
+
+void ppu_write_ctrl(nes *n, uint16_t addr, uint8_t val) {
+  (void)addr;
+  ppu *p = &n->ppu;
+  p->bus = val;
+  p->ctrl = val;
+  p->t = (p->t & 0xF3FF) | ((val & PPU_CTRL_NAMETABLE) << 10);
+  update_nmi(n);
+}
+
+void ppu_write_mask(nes *n, uint16_t addr, uint8_t val) {
+  (void)addr;
+  n->ppu.bus = val;
+  n->ppu.mask = val;
+}
+
+void ppu_write_oam_addr(nes *n, uint16_t addr, uint8_t val) {
+  (void)addr;
+  n->ppu.bus = val;
+  n->ppu.oam_addr = val;
+}
+
+void ppu_write_oam_data(nes *n, uint16_t addr, uint8_t val) {
+  (void)addr;
+  n->ppu.bus = val;
+  n->ppu.oam[n->ppu.oam_addr++] = val;
+}
+
+void ppu_write_scroll(nes *n, uint16_t addr, uint8_t val) {
+  (void)addr;
+  ppu *p = &n->ppu;
+  p->bus = val;
+  if (!p->w) {
+    p->t = (p->t & 0xFFE0) | (val >> 3);
+    p->x = val & 7;
+  } else {
+    p->t = (p->t & 0x8FFF) | ((val & 0x07) << 12);
+    p->t = (p->t & 0xFC1F) | ((val & 0xF8) << 2);
+  }
+  p->w = !p->w;
+}
+
+void ppu_write_addr(nes *n, uint16_t addr, uint8_t val) {
+  (void)addr;
+  ppu *p = &n->ppu;
+  p->bus = val;
+  if (!p->w) {
+    p->t = (p->t & 0x80FF) | ((val & 0x3F) << 8);
+  } else {
+    p->t = (p->t & 0xFF00) | val;
+    p->v = p->t;
+  }
+  p->w = !p->w;
+}
+
+void ppu_write_data(nes *n, uint16_t addr, uint8_t val) {
+  (void)addr;
+  ppu *p = &n->ppu;
+  p->bus = val;
+  ppu_write(n, p->v, val);
+  p->v += (p->ctrl & PPU_CTRL_INCREMENT) ? 32 : 1;
+}
+
+// Scrolling
+// https://www.nesdev.org/wiki/PPU_scrolling#Wrapping_around
+
+static void increment_x(ppu *p) {
+  if ((p->v & 0x001F) == 31) {
+    p->v &= ~0x001F;
+    p->v ^= 0x0400;
+  } else {
+    p->v++;
+  }
+}
+
+static void increment_y(ppu *p) {
+  if ((p->v & 0x7000) != 0x7000) {
+    p->v += 0x1000;
+    return;
+  }
+  p->v &= ~0x7000;
+  uint16_t y = (p->v & 0x03E0) >> 5;
+  if (y == 29) {
+    y = 0;
+    p->v ^= 0x0800;
+  } else if (y == 31) {
+    y = 0;
+  } else {
+    y++;
+  }
+  p->v = (p->v & ~0x03E0) | (y << 5);
+}
+
+static void copy_x(ppu *p) { p->v = (p->v & 0xFBE0) | (p->t & 0x041F); }
+
+static void copy_y(ppu *p) { p->v = (p->v & 0x841F) | (p->t & 0x7BE0); }
+
+// Background
+
+static void fetch_nametable(nes *n) {
+  n->ppu.nametable_latch = ppu_read(n, 0x2000 | (n->ppu.v & 0x0FFF));
+}
+
+static void fetch_attribute(nes *n) {
+  uint16_t v = n->ppu.v;
+  uint16_t addr = 0x23C0 | (v & 0x0C00) | ((v >> 4) & 0x38) | ((v >> 2) & 0x07);
+  uint8_t shift = ((v >> 4) & 4) | (v & 2);
+  n->ppu.attribute_latch = ((ppu_read(n, addr) >> shift) & 3) << 2;
+}
+
+static uint16_t background_pattern_addr(nes *n) {
+  uint16_t table = (n->ppu.ctrl & PPU_CTRL_BACKGROUND_TABLE) ? 0x1000 : 0;
+  uint16_t fine_y = (n->ppu.v >> 12) & 7;
+  return table + n->ppu.nametable_latch * 16 + fine_y;
+}
+
+static void store_tile(ppu *p) {
+  uint32_t data = 0;
+  uint8_t low = p->pattern_low_latch;
+  uint8_t high = p->pattern_high_latch;
+  for (int i = 0; i < 8; i++) {
+    data <<= 4;
+    data |= p->attribute_latch | ((low & 0x80) >> 7) | ((high & 0x80) >> 6);
+    low <<= 1;
+    high <<= 1;
+  }
+  p->tile_data |= data;
+}
+
+static uint8_t background_pixel(ppu *p, int x) {
+  if (!(p->mask & PPU_MASK_BACKGROUND) ||
+      (x < 8 && !(p->mask & PPU_MASK_BACKGROUND_LEFT))) {
+    return 0;
+  }
+  return (uint32_t)(p->tile_data >> 32) >> ((7 - p->x) * 4) & 0x0F;
+}
+
+// Sprites
+// https://www.nesdev.org/wiki/PPU_sprite_evaluation
+
+static uint32_t fetch_sprite_pattern(nes *n, int i, int row) {
+  ppu *p = &n->ppu;
+  uint8_t tile = p->oam[i * 4 + 1];
+  uint8_t attributes = p->oam[i * 4 + 2];
+  uint16_t addr;
+  if (!(p->ctrl & PPU_CTRL_SPRITE_SIZE)) {
+    if (attributes & 0x80) {
+      row = 7 - row;
+    }
+    uint16_t table = (p->ctrl & PPU_CTRL_SPRITE_TABLE) ? 0x1000 : 0;
+    addr = table + tile * 16 + row;
+  } else {
+    if (attributes & 0x80) {
+      row = 15 - row;
+    }
+    uint16_t table = (tile & 1) ? 0x1000 : 0;
+    tile &= 0xFE;
+    if (7 < row) {
+      tile++;
+      row -= 8;
+    }
+    addr = table + tile * 16 + row;
+  }
+
+  uint8_t palette = (attributes & 3) << 2;
+  uint8_t low = ppu_read(n, addr);
+  uint8_t high = ppu_read(n, addr + 8);
+  uint32_t data = 0;
+  for (int b = 0; b < 8; b++) {
+    data <<= 4;
+    if (attributes & 0x40) { // flip horizontally
+      data |= palette | (low & 1) | ((high & 1) << 1);
+      low >>= 1;
+      high >>= 1;
+    } else {
+      data |= palette | ((low & 0x80) >> 7) | ((high & 0x80) >> 6);
+      low <<= 1;
+      high <<= 1;
+    }
+  }
+  return data;
+}
+
+// Evaluate sprites on this scanline for the next one
+static void evaluate_sprites(nes *n) {
+  ppu *p = &n->ppu;
+  int height = (p->ctrl & PPU_CTRL_SPRITE_SIZE) ? 16 : 8;
+  uint64_t in_range = sprite_line_in_range(p->oam, p->scanline, height);
+  int count = 0;
+  for (uint64_t m = in_range; m && count < 8; m &= m - 1, count++) {
+    int i = __builtin_ctzll(m);
+    int row = p->scanline - p->oam[i * 4];
+    p->sprite_patterns[count] = fetch_sprite_pattern(n, i, row);
+    p->sprite_x[count] = p->oam[i * 4 + 3];
+    p->sprite_priorities[count] = (p->oam[i * 4 + 2] >> 5) & 1;
+    p->sprite_indexes[count] = i;
+  }
+  if (8 < __builtin_popcountll(in_range)) {
+    p->status |= PPU_STATUS_OVERFLOW;
+  }
+  p->sprite_count = count;
+  sprite_line_composite(p);
+}
+
+// A sprite_line pixel, see sprite_line.h
+static uint8_t sprite_pixel(const ppu *p, int x) {
+  if (!(p->mask & PPU_MASK_SPRITES) ||
+      (x < 8 && !(p->mask & PPU_MASK_SPRITES_LEFT))) {
+    return 0;
+  }
+  return p->sprite_line[x];
+}
+
+static void output_pixel(ppu *p, int x, int y, uint8_t offset) {
+  uint8_t index = p->palette[offset] & 0x3F;
+  if (p->mask & PPU_MASK_GRAYSCALE) {
+    index &= 0x30;
+  }
+  if (p->fb_index) {
+    p->fb_index[y * p->pitch + x] = index;
+  }
+  if (p->fb_rgb) {
+    p->fb_rgb[y * p->pitch + x] = ppu_palette_rgb[index];
+  }
+}
+
+static void render_pixel(nes *n) {
+  ppu *p = &n->ppu;
+  int x = p->dot - 1;
+  int y = p->scanline;
+
+  // without a frame buffer only sprite 0 hit is visible, and sprite 0 can
+  // only be the first sprite of a line
+  if (!p->fb_index && !p->fb_rgb &&
+      (p->sprite_count == 0 || p->sprite_indexes[0] != 0)) {
+    return;
+  }
+
+  uint8_t background = background_pixel(p, x);
+  uint8_t sprite = sprite_pixel(p, x);
+  uint8_t sprite_color = (sprite & SPRITE_LINE_COLOR) | 0x10;
+
+  uint8_t color;
+  if (!(background & 3)) {
+    color = (sprite & 3) ? sprite_color : 0;
+  } else if (!(sprite & 3)) {
+    color = background;
+  } else {
+    if ((sprite & SPRITE_LINE_ZERO) && x < 255) {
+      p->status |= PPU_STATUS_SPRITE_ZERO;
+    }
+    color = (sprite & SPRITE_LINE_BEHIND) ? background : sprite_color;
+  }
+
+  output_pixel(p, x, y, palette_offset(color));
+}
+
+// While rendering is disabled the backdrop color is shown, or the color at v
+// if it points into palette RAM
+// https://www.nesdev.org/wiki/PPU_palettes#The_background_palette_hack
+static void render_backdrop(nes *n) {
+  ppu *p = &n->ppu;
+  if (!p->fb_index && !p->fb_rgb) {
+    return;
+  }
+  uint16_t v = p->v & 0x3FFF;
+  output_pixel(p, p->dot - 1, p->scanline,
+               0x3F00 <= v ? palette_offset(v) : 0);
+}
+
+void ppu_step(nes *n) {
+  ppu *p = &n->ppu;
+
+  bool rendering = p->mask & (PPU_MASK_BACKGROUND | PPU_MASK_SPRITES);
+  bool pre_line = p->scanline == 261;
+  bool visible_line = p->scanline < 240;
+
+  if (rendering && (visible_line || pre_line)) {
+    bool visible_dot = 1 <= p->dot && p->dot <= 256;
+    bool fetch_dot = visible_dot || (321 <= p->dot && p->dot <= 336);
+
+    if (visible_line && visible_dot) {
+      render_pixel(n);
+    }
+    if (fetch_dot) {
+      p->tile_data <<= 4;
+      switch (p->dot & 7) {
+      case 1:
+        fetch_nametable(n);
+        break;
+      case 3:
+        fetch_attribute(n);
+        break;
+      case 5:
+        p->pattern_low_latch = ppu_read(n, background_pattern_addr(n));
+        break;
+      case 7:
+        p->pattern_high_latch = ppu_read(n, background_pattern_addr(n) + 8);
+        break;
+      case 0:
+        store_tile(p);
+        increment_x(p);
+        break;
+      }
+    }
+    if (p->dot == 256) {
+      increment_y(p);
+    }
+    if (p->dot == 257) {
+      copy_x(p);
+      if (visible_line) {
+        evaluate_sprites(n);
+      } else {
+        p->sprite_count = 0;
+        sprite_line_composite(p);
+      }
+    }
+    if (pre_line && 280 <= p->dot && p->dot <= 304) {
+      copy_y(p);
+    }
+  } else if (visible_line && 1 <= p->dot && p->dot <= 256) {
+    render_backdrop(n);
+  }
+
+  if (p->scanline == 241 && p->dot == 1) {
+    p->status |= PPU_STATUS_VBLANK;
+    p->frame++;
+    update_nmi(n);
+  }
+  if (pre_line && p->dot == 1) {
+    p->status &= ~(PPU_STATUS_VBLANK | PPU_STATUS_SPRITE_ZERO |
+                   PPU_STATUS_OVERFLOW);
+    update_nmi(n);
+  }
+
+  // the pre-render line is one dot shorter on odd frames while rendering
+  if (pre_line && p->dot == 339 && rendering && (p->frame & 1)) {
+    p->dot = 0;
+    p->scanline = 0;
+    return;
+  }
+  p->dot++;
+  if (340 < p->dot) {
+    p->dot = 0;
+    p->scanline++;
+    if (261 < p->scanline) {
+      p->scanline = 0;
+    }
+  }
+}
@@ -0,0 +1,31 @@
+#ifndef PPU_STEP_H
+#define PPU_STEP_H
+
+#include "nes.h"
+
+void ppu_power_on(nes *n);
+
+// Advance the PPU by one dot
+void ppu_step(nes *n);
+
+// Register handlers for the bus, see io_register in bus.h. Reads of
+// write-only registers and writes to PPUSTATUS go to the open bus latch.
+uint8_t ppu_read_open_bus(nes *n, uint16_t addr);
+uint8_t ppu_read_status(nes *n, uint16_t addr);   // $2002
+uint8_t ppu_read_oam_data(nes *n, uint16_t addr); // $2004
+uint8_t ppu_read_data(nes *n, uint16_t addr);     // $2007
+
+// Reads of $2002 and $2007 without their side effects
+uint8_t ppu_peek_status(const nes *n, uint16_t addr);
+uint8_t ppu_peek_data(const nes *n, uint16_t addr);
+
+void ppu_write_open_bus(nes *n, uint16_t addr, uint8_t val);
+void ppu_write_ctrl(nes *n, uint16_t addr, uint8_t val);     // $2000
+void ppu_write_mask(nes *n, uint16_t addr, uint8_t val);     // $2001
+void ppu_write_oam_addr(nes *n, uint16_t addr, uint8_t val); // $2003
+void ppu_write_oam_data(nes *n, uint16_t addr, uint8_t val); // $2004
+void ppu_write_scroll(nes *n, uint16_t addr, uint8_t val);   // $2005
+void ppu_write_addr(nes *n, uint16_t addr, uint8_t val);     // $2006
+void ppu_write_data(nes *n, uint16_t addr, uint8_t val);     // $2007
+
+#endif // PPU_STEP_H
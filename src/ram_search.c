@@ -0,0 +1,184 @@
+#include "ram_search.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RAM_SEARCH_X86
+#endif
+
+// A kernel narrows words of candidates with the comparison of a and b, or of
+// a and value if b is NULL. size is a multiple of 64 bytes, one word each.
+typedef void (*kernel)(uint64_t *words, const uint8_t *a, const uint8_t *b,
+                       uint8_t value, ram_search_op op, size_t size);
+
+// Each comparison is a byte equality, optionally negated:
+// a <= b iff min(a, b) == a, a >= b iff max(a, b) == a.
+static bool negated(ram_search_op op) {
+  return op == RAM_SEARCH_NE || op == RAM_SEARCH_LT || op == RAM_SEARCH_GT;
+}
+
+static bool compare(uint8_t a, uint8_t b, ram_search_op op) {
+  switch (op) {
+  case RAM_SEARCH_EQ:
+    return a == b;
+  case RAM_SEARCH_NE:
+    return a != b;
+  case RAM_SEARCH_LT:
+    return a < b;
+  case RAM_SEARCH_LE:
+    return a <= b;
+  case RAM_SEARCH_GT:
+    return a > b;
+  case RAM_SEARCH_GE:
+    return a >= b;
+  }
+  return false;
+}
+
+static void narrow_scalar(uint64_t *words, const uint8_t *a, const uint8_t *b,
+                          uint8_t value, ram_search_op op, size_t size) {
+  for (size_t w = 0; w < size / 64; w++) {
+    if (!words[w]) {
+      continue;
+    }
+    uint64_t mask = 0;
+    for (int i = 0; i < 64; i++) {
+      size_t j = w * 64 + i;
+      mask |= (uint64_t)compare(a[j], b ? b[j] : value, op) << i;
+    }
+    words[w] &= mask;
+  }
+}
+
+#ifdef RAM_SEARCH_X86
+#define NARROW_KERNEL(name, isa, vec, width, load, set1, cmpeq, min, max,  \
+                      movemask)                                                \
+  __attribute__((target(isa))) static void name(                              \
+      uint64_t *words, const uint8_t *a, const uint8_t *b, uint8_t value,     \
+      ram_search_op op, size_t size) {                                        \
+    uint64_t flip = negated(op) ? ~0ULL : 0;                                  \
+    vec constant = set1((char)value);                                         \
+    for (size_t w = 0; w < size / 64; w++) {                                  \
+      if (!words[w]) {                                                        \
+        continue;                                                             \
+      }                                                                       \
+      uint64_t mask = 0;                                                      \
+      for (int i = 0; i < 64; i += width) {                                   \
+        size_t j = w * 64 + i;                                                \
+        vec x = load((const vec *)(a + j));                                   \
+        vec y = b ? load((const vec *)(b + j)) : constant;                    \
+        vec m;                                                                \
+        switch (op) {                                                         \
+        case RAM_SEARCH_EQ:                                                   \
+        case RAM_SEARCH_NE:                                                   \
+          m = cmpeq(x, y);                                                    \
+          break;                                                              \
+        case RAM_SEARCH_LE:                                                   \
+        case RAM_SEARCH_GT:                                                   \
+          m = cmpeq(min(x, y), x);                                            \
+          break;                                                              \
+        default:                                                              \
+          m = cmpeq(max(x, y), x);                                            \
+          break;                                                              \
+        }                                                                     \
+        mask |= (uint64_t)(uint32_t)movemask(m) << i;                         \
+      }                                                                       \
+      words[w] &= mask ^ flip;                                                \
+    }                                                                         \
+  }
+
+NARROW_KERNEL(narrow_sse2, "sse2", __m128i, 16, _mm_loadu_si128, _mm_set1_epi8,
+              _mm_cmpeq_epi8, _mm_min_epu8, _mm_max_epu8, _mm_movemask_epi8)
+NARROW_KERNEL(narrow_avx2, "avx2", __m256i, 32, _mm256_loadu_si256,
+              _mm256_set1_epi8, _mm256_cmpeq_epi8, _mm256_min_epu8,
+              _mm256_max_epu8, _mm256_movemask_epi8)
+#endif
+
+static kernel k;
+static pthread_once_t k_once = PTHREAD_ONCE_INIT;
+
+static bool use(const char *isa) {
+  if (strcmp(isa, "scalar") == 0) {
+    k = narrow_scalar;
+    return true;
+  }
+#ifdef RAM_SEARCH_X86
+  if (strcmp(isa, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+    k = narrow_avx2;
+    return true;
+  }
+  if (strcmp(isa, "sse2") == 0 && __builtin_cpu_supports("sse2")) {
+    k = narrow_sse2;
+    return true;
+  }
+#endif
+  return false;
+}
+
+static void use_best(void) {
+  if (!use("avx2") && !use("sse2")) {
+    use("scalar");
+  }
+}
+
+bool ram_search_select(const char *isa) {
+  // the default is set first, so that it never replaces the kernel selected
+  pthread_once(&k_once, use_best);
+  return use(isa);
+}
+
+static size_t narrow(ram_search *s, const nes *const *a, const nes *const *b,
+                     size_t count, ram_search_op op, uint8_t value) {
+  pthread_once(&k_once, use_best);
+  const size_t ram_words = sizeof(a[0]->ram) / 64;
+  for (size_t i = 0; i < count; i++) {
+    k(s->candidates, a[i]->ram, b ? b[i]->ram : NULL, value, op,
+      sizeof(a[i]->ram));
+    k(s->candidates + ram_words, cartridge_prg_ram(&a[i]->cartridge),
+      b ? cartridge_prg_ram(&b[i]->cartridge) : NULL, value, op,
+      sizeof(a[i]->cartridge.prg_ram));
+  }
+  return ram_search_count(s);
+}
+
+void ram_search_reset(ram_search *s) {
+  memset(s->candidates, 0xFF, sizeof(s->candidates));
+}
+
+size_t ram_search_value(ram_search *s, const nes *const *states, size_t count,
+                        ram_search_op op, uint8_t value) {
+  return narrow(s, states, NULL, count, op, value);
+}
+
+size_t ram_search_compare(ram_search *s, const nes *const *current,
+                          const nes *const *previous, size_t count,
+                          ram_search_op op) {
+  return narrow(s, current, previous, count, op, 0);
+}
+
+size_t ram_search_count(const ram_search *s) {
+  size_t count = 0;
+  for (size_t i = 0; i < RAM_SEARCH_SIZE / 64; i++) {
+    count += __builtin_popcountll(s->candidates[i]);
+  }
+  return count;
+}
+
+size_t ram_search_next(const ram_search *s, size_t index) {
+  for (size_t w = index / 64; w < RAM_SEARCH_SIZE / 64; w++) {
+    uint64_t bits = s->candidates[w];
+    if (w == index / 64) {
+      bits &= ~0ULL << (index % 64);
+    }
+    if (bits) {
+      return w * 64 + __builtin_ctzll(bits);
+    }
+  }
+  return RAM_SEARCH_SIZE;
+}
+
+uint16_t ram_search_address(size_t index) {
+  return index < 0x800 ? index : 0x6000 + (index - 0x800);
+}
@@ -0,0 +1,59 @@
+#ifndef RAM_SEARCH_H
+#define RAM_SEARCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nes.h"
+
+// RAM search, e.g. to locate the lives counter by narrowing down addresses
+// whose value "equals 3", then "decreased since the last snapshot".
+//
+// Candidates are the 2KB of RAM followed by the 8KB of PRG RAM, one bit each.
+// Every narrowing step keeps the candidates for which a comparison holds in
+// all the given states, read in place from nes or saved state structs.
+// Blocks of 64 candidates already ruled out are skipped.
+
+#define RAM_SEARCH_SIZE (0x800 + 0x2000)
+
+typedef enum RamSearchOp {
+  RAM_SEARCH_EQ,
+  RAM_SEARCH_NE,
+  RAM_SEARCH_LT,
+  RAM_SEARCH_LE,
+  RAM_SEARCH_GT,
+  RAM_SEARCH_GE,
+} ram_search_op;
+
+typedef struct RamSearch {
+  uint64_t candidates[RAM_SEARCH_SIZE / 64];
+} ram_search;
+
+// Start with every address as a candidate
+void ram_search_reset(ram_search *s);
+
+// Keep candidates where "state op value" holds in every state. Returns the
+// number of candidates left.
+size_t ram_search_value(ram_search *s, const nes *const *states, size_t count,
+                        ram_search_op op, uint8_t value);
+
+// Keep candidates where "current[i] op previous[i]" holds for every i, e.g.
+// RAM_SEARCH_LT for "decreased"
+size_t ram_search_compare(ram_search *s, const nes *const *current,
+                          const nes *const *previous, size_t count,
+                          ram_search_op op);
+
+size_t ram_search_count(const ram_search *s);
+
+// Candidate index of the first candidate from index on, or RAM_SEARCH_SIZE
+size_t ram_search_next(const ram_search *s, size_t index);
+
+// CPU address of a candidate index, $0000-$07FF or $6000-$7FFF
+uint16_t ram_search_address(size_t index);
+
+// Use the kernels for isa: "avx2", "sse2" or "scalar". Returns false if the
+// CPU lacks it. By default the best one available is used.
+bool ram_search_select(const char *isa);
+
+#endif // RAM_SEARCH_H
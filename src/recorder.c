@@ -0,0 +1,156 @@
+#include "recorder.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "io.h"
+#include "ppu.h"
+
+struct Recorder {
+  int video_fd, audio_fd;
+
+  recorder_frame *frames;
+  size_t pool_size;
+
+  // Both are rings of pool_size frames: free frames and frames to be written
+  recorder_frame **free, **queue;
+  size_t free_head, free_count;
+  size_t queue_head, queue_count;
+  bool closing;
+  bool failed;
+
+  pthread_mutex_t lock;
+  pthread_cond_t frame_freed;
+  pthread_cond_t frame_queued;
+  pthread_t writer;
+
+  // backing store of all frames
+  uint32_t *video;
+  int16_t *audio;
+};
+
+static void *writer_main(void *arg) {
+  recorder *r = arg;
+  pthread_mutex_lock(&r->lock);
+  for (;;) {
+    while (r->queue_count == 0 && !r->closing) {
+      pthread_cond_wait(&r->frame_queued, &r->lock);
+    }
+    if (r->queue_count == 0) {
+      break; // closing and drained
+    }
+    recorder_frame *f = r->queue[r->queue_head];
+    r->queue_head = (r->queue_head + 1) % r->pool_size;
+    r->queue_count--;
+    bool failed = r->failed;
+    pthread_mutex_unlock(&r->lock);
+
+    // after a failure frames are only recycled, so the emulation thread
+    // never waits on a dead writer
+    if (!failed && 0 <= r->video_fd) {
+      failed = !write_full(r->video_fd, f->video,
+                          PPU_WIDTH * PPU_HEIGHT * sizeof(uint32_t));
+    }
+    if (!failed && 0 <= r->audio_fd) {
+      failed = !write_full(r->audio_fd, f->audio,
+                           f->audio_samples * sizeof(int16_t));
+    }
+
+    pthread_mutex_lock(&r->lock);
+    r->failed = failed;
+    r->free[(r->free_head + r->free_count) % r->pool_size] = f;
+    r->free_count++;
+    pthread_cond_signal(&r->frame_freed);
+  }
+  pthread_mutex_unlock(&r->lock);
+  return NULL;
+}
+
+recorder *recorder_open(int video_fd, int audio_fd, size_t pool_size) {
+  if (pool_size == 0) {
+    return NULL;
+  }
+  recorder *r = calloc(1, sizeof(recorder));
+  if (!r) {
+    return NULL;
+  }
+  r->video_fd = video_fd;
+  r->audio_fd = audio_fd;
+  r->pool_size = pool_size;
+  r->frames = calloc(pool_size, sizeof(recorder_frame));
+  r->free = calloc(pool_size, sizeof(recorder_frame *));
+  r->queue = calloc(pool_size, sizeof(recorder_frame *));
+  r->video = calloc(pool_size * PPU_WIDTH * PPU_HEIGHT, sizeof(uint32_t));
+  r->audio = calloc(pool_size * RECORDER_AUDIO_CAPACITY, sizeof(int16_t));
+  if (!r->frames || !r->free || !r->queue || !r->video || !r->audio) {
+    goto fail;
+  }
+  for (size_t i = 0; i < pool_size; i++) {
+    r->frames[i].video = r->video + i * PPU_WIDTH * PPU_HEIGHT;
+    r->frames[i].audio = r->audio + i * RECORDER_AUDIO_CAPACITY;
+    r->free[i] = &r->frames[i];
+  }
+  r->free_count = pool_size;
+
+  pthread_mutex_init(&r->lock, NULL);
+  pthread_cond_init(&r->frame_freed, NULL);
+  pthread_cond_init(&r->frame_queued, NULL);
+  if (pthread_create(&r->writer, NULL, writer_main, r) != 0) {
+    pthread_mutex_destroy(&r->lock);
+    pthread_cond_destroy(&r->frame_freed);
+    pthread_cond_destroy(&r->frame_queued);
+    goto fail;
+  }
+  return r;
+
+fail:
+  free(r->frames);
+  free(r->free);
+  free(r->queue);
+  free(r->video);
+  free(r->audio);
+  free(r);
+  return NULL;
+}
+
+recorder_frame *recorder_acquire(recorder *r) {
+  pthread_mutex_lock(&r->lock);
+  while (r->free_count == 0) {
+    pthread_cond_wait(&r->frame_freed, &r->lock);
+  }
+  recorder_frame *f = r->free[r->free_head];
+  r->free_head = (r->free_head + 1) % r->pool_size;
+  r->free_count--;
+  pthread_mutex_unlock(&r->lock);
+
+  f->audio_samples = 0;
+  return f;
+}
+
+void recorder_submit(recorder *r, recorder_frame *f) {
+  pthread_mutex_lock(&r->lock);
+  r->queue[(r->queue_head + r->queue_count) % r->pool_size] = f;
+  r->queue_count++;
+  pthread_cond_signal(&r->frame_queued);
+  pthread_mutex_unlock(&r->lock);
+}
+
+bool recorder_close(recorder *r) {
+  pthread_mutex_lock(&r->lock);
+  r->closing = true;
+  pthread_cond_signal(&r->frame_queued);
+  pthread_mutex_unlock(&r->lock);
+  pthread_join(r->writer, NULL);
+
+  bool ok = !r->failed;
+  pthread_mutex_destroy(&r->lock);
+  pthread_cond_destroy(&r->frame_freed);
+  pthread_cond_destroy(&r->frame_queued);
+  free(r->frames);
+  free(r->free);
+  free(r->queue);
+  free(r->video);
+  free(r->audio);
+  free(r);
+  return ok;
+}
@@ -0,0 +1,43 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Headless recording of raw frames and PCM for offline encoding.
+//
+// Frames are taken from a fixed pool, filled by the emulation thread and
+// written by a dedicated writer thread, so the emulation thread never does
+// I/O or allocates after recorder_open(). It only waits in recorder_acquire()
+// when every frame of the pool is queued for writing.
+//
+// Video is written as PPU_WIDTH x PPU_HEIGHT 0x00RRGGBB pixels in host byte
+// order (ffmpeg -f rawvideo -pix_fmt bgr0 -s 256x240 on little endian hosts),
+// audio as signed 16-bit mono samples in host byte order.
+
+#define RECORDER_AUDIO_CAPACITY 2048
+
+typedef struct RecorderFrame {
+  uint32_t *video; // PPU_WIDTH * PPU_HEIGHT pixels, pitch PPU_WIDTH
+  int16_t *audio;  // RECORDER_AUDIO_CAPACITY samples
+  size_t audio_samples;
+} recorder_frame;
+
+typedef struct Recorder recorder;
+
+// Start a writer thread for the given file descriptors. Either may be -1 to
+// drop that stream. Returns NULL on failure.
+recorder *recorder_open(int video_fd, int audio_fd, size_t pool_size);
+
+// Take a free frame from the pool
+recorder_frame *recorder_acquire(recorder *r);
+
+// Queue a frame taken by recorder_acquire() for writing
+void recorder_submit(recorder *r, recorder_frame *f);
+
+// Write all queued frames and stop the writer thread. Returns false if any
+// write failed.
+bool recorder_close(recorder *r);
+
+#endif // RECORDER_H
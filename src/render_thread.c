@@ -0,0 +1,221 @@
+#include "render_thread.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bus.h"
+#include "ppu_step.h"
+
+#define RENDER_QUEUE_SIZE (1 << 16)
+
+typedef struct RenderEvent {
+  uint64_t stamp;
+  uint16_t addr;
+  uint8_t value;
+  uint8_t kind; // render_event_kind
+} render_event;
+
+struct RenderThread {
+  nes shadow;
+  nes *n;
+
+  render_event *events; // RENDER_QUEUE_SIZE
+  _Atomic size_t head;  // pushed by the emulation thread
+  _Atomic size_t tail;  // popped by the render thread
+
+  uint32_t *frames; // ring of frame_count frames
+  uintmax_t *frame_numbers;
+  size_t frame_count;
+  size_t rendered, released; // frames drawn and given back
+  bool closing;
+
+  pthread_mutex_t lock;
+  pthread_cond_t wake;     // to the render thread
+  pthread_cond_t finished; // to render_thread_wait()
+  pthread_t thread;
+};
+
+// Position of a PPU as dots since power on. A frame starts at scanline 241
+// dot 2, right after ppu.frame is incremented, so the position increases
+// monotonically across the frame counter, the scanline wrap and the skipped
+// dot of odd frames.
+#define DOTS_PER_FRAME (262 * 341)
+
+static uint64_t position(const ppu *p) {
+  uint64_t line = (p->scanline + 262 - 241) % 262;
+  uint64_t dot = (line * 341 + p->dot + DOTS_PER_FRAME - 2) % DOTS_PER_FRAME;
+  return (uint64_t)p->frame * DOTS_PER_FRAME + dot;
+}
+
+void render_thread_record(nes *n, render_event_kind kind, uint16_t addr,
+                          uint8_t value) {
+  render_thread *r = n->render_thread;
+  size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+  while (head - atomic_load_explicit(&r->tail, memory_order_acquire) ==
+         RENDER_QUEUE_SIZE) {
+    pthread_mutex_lock(&r->lock);
+    pthread_cond_signal(&r->wake);
+    pthread_mutex_unlock(&r->lock);
+    sched_yield();
+  }
+  r->events[head % RENDER_QUEUE_SIZE] =
+      (render_event){position(&n->ppu), addr, value, kind};
+  atomic_store_explicit(&r->head, head + 1, memory_order_release);
+}
+
+// Hand over the frame just finished, if it was drawn, and draw the next one
+// into a free buffer if there is one
+static void publish(render_thread *r) {
+  nes *s = &r->shadow;
+  pthread_mutex_lock(&r->lock);
+  if (s->ppu.fb_rgb) {
+    r->frame_numbers[r->rendered % r->frame_count] = s->ppu.frame;
+    r->rendered++;
+    pthread_cond_signal(&r->finished);
+  }
+  bool full = r->rendered - r->released == r->frame_count;
+  pthread_mutex_unlock(&r->lock);
+  size_t next = r->rendered % r->frame_count;
+  s->ppu.fb_rgb = full ? NULL : r->frames + next * PPU_WIDTH * PPU_HEIGHT;
+}
+
+static void replay(render_thread *r, const render_event *e) {
+  nes *s = &r->shadow;
+  while (position(&s->ppu) < e->stamp) {
+    uintmax_t frame = s->ppu.frame;
+    ppu_step(s);
+    if (s->ppu.frame != frame) {
+      publish(r);
+    }
+  }
+  switch (e->kind) {
+  case RENDER_EVENT_READ:
+    bus_read(s, e->addr);
+    break;
+  case RENDER_EVENT_WRITE:
+    bus_write(s, e->addr, e->value);
+    break;
+  case RENDER_EVENT_OAM:
+    s->ppu.oam[e->addr] = e->value;
+    break;
+  }
+}
+
+static void *render_main(void *arg) {
+  render_thread *r = arg;
+  for (;;) {
+    pthread_mutex_lock(&r->lock);
+    while (atomic_load(&r->head) == atomic_load(&r->tail) && !r->closing) {
+      pthread_cond_wait(&r->wake, &r->lock);
+    }
+    bool closing = r->closing;
+    pthread_mutex_unlock(&r->lock);
+    if (closing) {
+      return NULL;
+    }
+
+    size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    for (; tail != head; tail++) {
+      replay(r, &r->events[tail % RENDER_QUEUE_SIZE]);
+      atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+    }
+  }
+}
+
+render_thread *render_thread_open(nes *n, size_t frames) {
+  if (frames == 0 || n->render_thread) {
+    return NULL;
+  }
+  render_thread *r = aligned_alloc(_Alignof(render_thread), sizeof(*r));
+  if (!r) {
+    return NULL;
+  }
+  memset(r, 0, sizeof(*r));
+  r->n = n;
+  r->frame_count = frames;
+  r->events = calloc(RENDER_QUEUE_SIZE, sizeof(render_event));
+  r->frames = calloc(frames * PPU_WIDTH * PPU_HEIGHT, sizeof(uint32_t));
+  r->frame_numbers = calloc(frames, sizeof(uintmax_t));
+  nes *state = aligned_alloc(NES_CACHE_LINE, sizeof(nes));
+  if (!r->events || !r->frames || !r->frame_numbers || !state) {
+    free(state);
+    free(r->events);
+    free(r->frames);
+    free(r->frame_numbers);
+    free(r);
+    return NULL;
+  }
+
+  // a plain copy of the machine without the instrumentation of n
+  nes_init(&r->shadow);
+  r->shadow.cartridge.prg_rom = n->cartridge.prg_rom;
+  r->shadow.cartridge.chr_rom = n->cartridge.chr_rom;
+  nes_save_state(n, state);
+  nes_load_state(&r->shadow, state);
+  free(state);
+  r->shadow.ppu.fb_rgb = r->frames;
+  r->shadow.ppu.pitch = PPU_WIDTH;
+
+  pthread_mutex_init(&r->lock, NULL);
+  pthread_cond_init(&r->wake, NULL);
+  pthread_cond_init(&r->finished, NULL);
+  if (pthread_create(&r->thread, NULL, render_main, r) != 0) {
+    pthread_mutex_destroy(&r->lock);
+    pthread_cond_destroy(&r->wake);
+    pthread_cond_destroy(&r->finished);
+    free(r->events);
+    free(r->frames);
+    free(r->frame_numbers);
+    free(r);
+    return NULL;
+  }
+  n->render_thread = r;
+  return r;
+}
+
+nes_frame render_thread_run_frame(render_thread *r) {
+  nes_frame f = nes_run_frame(r->n, NULL, 0);
+  render_thread_record(r->n, RENDER_EVENT_FRAME, 0, 0);
+  pthread_mutex_lock(&r->lock);
+  pthread_cond_signal(&r->wake);
+  pthread_mutex_unlock(&r->lock);
+  return f;
+}
+
+const uint32_t *render_thread_wait(render_thread *r, uintmax_t *frame) {
+  pthread_mutex_lock(&r->lock);
+  while (r->released == r->rendered) {
+    pthread_cond_wait(&r->finished, &r->lock);
+  }
+  size_t i = r->released % r->frame_count;
+  *frame = r->frame_numbers[i];
+  pthread_mutex_unlock(&r->lock);
+  return r->frames + i * PPU_WIDTH * PPU_HEIGHT;
+}
+
+void render_thread_release(render_thread *r) {
+  pthread_mutex_lock(&r->lock);
+  r->released++;
+  pthread_mutex_unlock(&r->lock);
+}
+
+void render_thread_close(render_thread *r) {
+  pthread_mutex_lock(&r->lock);
+  r->closing = true;
+  pthread_cond_signal(&r->wake);
+  pthread_mutex_unlock(&r->lock);
+  pthread_join(r->thread, NULL);
+
+  r->n->render_thread = NULL;
+  pthread_mutex_destroy(&r->lock);
+  pthread_cond_destroy(&r->wake);
+  pthread_cond_destroy(&r->finished);
+  free(r->events);
+  free(r->frames);
+  free(r->frame_numbers);
+  free(r);
+}
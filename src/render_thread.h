@@ -0,0 +1,53 @@
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nes.h"
+
+// Pixel rendering on a second thread
+//
+// The emulation thread runs frames without rendering, so its PPU only keeps
+// what the CPU can observe (status flags, sprite 0 hit, NMI). Every PPU
+// register access and OAM DMA byte is pushed to a lock-free single-producer
+// single-consumer queue, stamped with the PPU position it happened at. The
+// render thread replays them at the same positions on a shadow PPU that draws
+// the frame, while the emulation thread moves on to the next one.
+//
+// The shadow is a copy of the machine taken by render_thread_open(). Loading
+// another state into n requires closing and reopening the render thread.
+
+typedef struct RenderThread render_thread;
+
+// Start rendering for n into a ring of frames buffers of PPU_WIDTH x
+// PPU_HEIGHT 0x00RRGGBB pixels. While all of them hold frames not yet
+// released, further frames are emulated but not drawn, so a slow consumer
+// drops frames instead of delaying emulation. Returns NULL on failure.
+render_thread *render_thread_open(nes *n, size_t frames);
+
+// Run a frame of n on the calling thread and queue it for rendering. Only
+// waits if the render thread is a whole event queue behind.
+nes_frame render_thread_run_frame(render_thread *r);
+
+// Wait for the oldest drawn frame not yet released, pitch PPU_WIDTH. frame is
+// set to its nes_frame.frame.
+const uint32_t *render_thread_wait(render_thread *r, uintmax_t *frame);
+
+void render_thread_release(render_thread *r);
+
+// Stop the render thread and detach it from n, dropping frames not yet drawn
+void render_thread_close(render_thread *r);
+
+// From the bus: a PPU register read or write, or an OAM DMA byte
+typedef enum RenderEventKind {
+  RENDER_EVENT_READ,
+  RENDER_EVENT_WRITE,
+  RENDER_EVENT_OAM,
+  RENDER_EVENT_FRAME, // end of a frame on the emulation thread
+} render_event_kind;
+
+void render_thread_record(nes *n, render_event_kind kind, uint16_t addr,
+                          uint8_t value);
+
+#endif // RENDER_THREAD_H
@@ -0,0 +1,95 @@
+#include "rollback.h"
+
+#include <string.h>
+#include <time.h>
+
+void rollback_init(rollback *r, nes *n) {
+  memset(r, 0, sizeof(*r));
+  r->n = n;
+  r->rollback_to = UINT32_MAX;
+}
+
+// Take over the ring slot of frame from the frame ROLLBACK_FRAMES before
+static int claim_slot(rollback *r, uint32_t frame) {
+  int slot = frame % ROLLBACK_FRAMES;
+  if (r->slot_frames[slot] != frame) {
+    r->slot_frames[slot] = frame;
+    r->received[slot] = 0;
+  }
+  return slot;
+}
+
+bool rollback_set_input(rollback *r, uint32_t frame, int port,
+                        uint8_t buttons) {
+  if (r->frame < frame || frame + ROLLBACK_FRAMES <= r->frame) {
+    return false;
+  }
+  int slot = claim_slot(r, frame);
+  if (frame < r->frame && r->inputs[slot][port] != buttons &&
+      frame < r->rollback_to) {
+    r->rollback_to = frame; // ran with a wrong prediction
+  }
+  r->inputs[slot][port] = buttons;
+  r->received[slot] |= 1 << port;
+  return true;
+}
+
+// Predict the inputs of frame that have not arrived from the previous frame
+static void predict(rollback *r, uint32_t frame) {
+  int slot = frame % ROLLBACK_FRAMES;
+  int prev = (frame + ROLLBACK_FRAMES - 1) % ROLLBACK_FRAMES;
+  for (int port = 0; port < 2; port++) {
+    if (!(r->received[slot] & (1 << port))) {
+      r->inputs[slot][port] = frame ? r->inputs[prev][port] : 0;
+    }
+  }
+}
+
+static nes_frame run(rollback *r, uint32_t frame, uint32_t *fb,
+                     size_t pitch) {
+  int slot = frame % ROLLBACK_FRAMES;
+  nes_save_state(r->n, &r->states[slot]);
+  nes_set_buttons(r->n, 0, r->inputs[slot][0]);
+  nes_set_buttons(r->n, 1, r->inputs[slot][1]);
+  return nes_run_frame(r->n, fb, pitch);
+}
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void rollback_resimulate(rollback *r) {
+  if (r->rollback_to == UINT32_MAX) {
+    return;
+  }
+  // the newest state still valid is the one before the first wrong input
+  nes_load_state(r->n, &r->states[r->rollback_to % ROLLBACK_FRAMES]);
+  for (uint32_t f = r->rollback_to; f < r->frame; f++) {
+    uint64_t start = now_ns();
+    // later predictions may rest on the corrected input, while the slot
+    // before rollback_to may already belong to the present frame
+    if (f != r->rollback_to) {
+      predict(r, f);
+    }
+    run(r, f, NULL, 0);
+    uint64_t elapsed = now_ns() - start;
+    if (r->worst_resimulation_ns < elapsed) {
+      r->worst_resimulation_ns = elapsed;
+    }
+    r->resimulated_frames++;
+  }
+  r->rollback_to = UINT32_MAX;
+}
+
+nes_frame rollback_advance(rollback *r, uint32_t *fb, size_t pitch) {
+  rollback_resimulate(r);
+
+  claim_slot(r, r->frame);
+  predict(r, r->frame);
+
+  nes_frame result = run(r, r->frame, fb, pitch);
+  r->frame++;
+  return result;
+}
@@ -0,0 +1,53 @@
+#ifndef ROLLBACK_H
+#define ROLLBACK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nes.h"
+
+// Rollback resimulation for late-arriving inputs
+//
+// The state at the start of each of the last ROLLBACK_FRAMES frames is kept in
+// a ring. A frame whose input has not arrived runs with the input predicted
+// from the previous frame. When the real input arrives and differs, the state
+// at the start of that frame is restored and the frames up to the present are
+// resimulated without rendering, predicting again the inputs that have still
+// not arrived.
+
+#define ROLLBACK_FRAMES 8
+
+typedef struct Rollback {
+  nes *n;
+  // next frame to run, frames before it have been run at least once
+  uint32_t frame;
+  // earliest frame run with a wrong prediction, or UINT32_MAX
+  uint32_t rollback_to;
+
+  // per frame % ROLLBACK_FRAMES
+  nes states[ROLLBACK_FRAMES]; // state at the start of the frame
+  uint32_t slot_frames[ROLLBACK_FRAMES]; // frame the slot belongs to
+  uint8_t inputs[ROLLBACK_FRAMES][2];
+  uint8_t received[ROLLBACK_FRAMES]; // bit per port
+
+  // statistics
+  uintmax_t resimulated_frames;
+  uint64_t worst_resimulation_ns; // per resimulated frame
+} rollback;
+
+// n must be powered on with its ROM loaded, and outlive r
+void rollback_init(rollback *r, nes *n);
+
+// Deliver the input of port for frame. Returns false if the frame is too old
+// to roll back to, or has not been reached yet.
+bool rollback_set_input(rollback *r, uint32_t frame, int port,
+                        uint8_t buttons);
+
+// Resimulate frames with corrected inputs up to the present
+void rollback_resimulate(rollback *r);
+
+// Resimulate if needed, then run the next frame rendering into fb as
+// nes_run_frame()
+nes_frame rollback_advance(rollback *r, uint32_t *fb, size_t pitch);
+
+#endif // ROLLBACK_H
@@ -0,0 +1,314 @@
+#include "search.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+_Static_assert(sizeof(nes) <= UINT16_MAX, "delta offsets are 16-bit");
+
+struct Search {
+  search_options o;
+  const uint8_t *prg_rom, *chr_rom; // the root's ROM image
+  nes root;                          // saved root state
+
+  search_node *nodes;
+  atomic_size_t node_count;
+  atomic_bool full;
+
+  // saved states of frontier nodes, by node index
+  nes **states;
+  uint32_t *frontier;
+  size_t frontier_count;
+  uint32_t *next;
+  atomic_size_t next_count;
+  atomic_size_t cursor; // next frontier entry to expand
+
+  // open addressing set of identity hashes, 0 is empty
+  _Atomic uint64_t *visited;
+  size_t visited_mask;
+};
+
+uint64_t search_state_hash(nes *state) {
+  uintmax_t cycles = state->cpu.cycles;
+  uintmax_t frame = state->ppu.frame;
+  uint8_t buttons[2] = {state->controllers[0].buttons,
+                        state->controllers[1].buttons};
+  state->cpu.cycles &= 1; // OAM DMA timing depends on the parity
+  state->ppu.frame = 0;
+  // every expansion sets the buttons before the game can read them, while
+  // the shift register and strobe are latched by the game and read later
+  state->controllers[0].buttons = 0;
+  state->controllers[1].buttons = 0;
+  uint64_t h = nes_state_hash(state);
+  state->cpu.cycles = cycles;
+  state->ppu.frame = frame;
+  state->controllers[0].buttons = buttons[0];
+  state->controllers[1].buttons = buttons[1];
+  return h ? h : 1;
+}
+
+// Returns false if h was already visited
+static bool visit(search *s, uint64_t h) {
+  for (size_t i = h & s->visited_mask;; i = (i + 1) & s->visited_mask) {
+    uint64_t current =
+        atomic_load_explicit(&s->visited[i], memory_order_relaxed);
+    if (current == h) {
+      return false;
+    }
+    if (current == 0) {
+      uint64_t expected = 0;
+      if (atomic_compare_exchange_strong(&s->visited[i], &expected, h)) {
+        return true;
+      }
+      if (expected == h) {
+        return false;
+      }
+    }
+  }
+}
+
+// Delta of child from parent: runs of (uint16 skip, uint16 length, bytes).
+// A run ends at 4 equal bytes in a row, so short gaps are copied rather than
+// split into runs.
+static size_t encode_delta(const uint8_t *parent, const uint8_t *child,
+                           size_t size, uint8_t *out) {
+  size_t o = 0;
+  size_t last = 0;
+  size_t i = 0;
+  while (i < size) {
+    if (parent[i] == child[i]) {
+      i++;
+      continue;
+    }
+    size_t start = i;
+    size_t equal = 0;
+    for (; i < size && equal < 4 && i - start < UINT16_MAX; i++) {
+      equal = parent[i] == child[i] ? equal + 1 : 0;
+    }
+    size_t len = i - start - equal;
+    uint16_t header[2] = {start - last, len};
+    memcpy(out + o, header, sizeof(header));
+    memcpy(out + o + sizeof(header), child + start, len);
+    o += sizeof(header) + len;
+    last = start + len;
+  }
+  return o;
+}
+
+static void apply_delta(uint8_t *state, const uint8_t *delta, size_t size) {
+  size_t pos = 0;
+  for (size_t o = 0; o < size;) {
+    uint16_t header[2];
+    memcpy(header, delta + o, sizeof(header));
+    pos += header[0];
+    memcpy(state + pos, delta + o + sizeof(header), header[1]);
+    pos += header[1];
+    o += sizeof(header) + header[1];
+  }
+}
+
+typedef struct Worker {
+  search *s;
+  nes machine;
+  nes child;
+  uint8_t delta[sizeof(nes) * 2];
+} worker;
+
+static void expand(worker *w, uint32_t parent) {
+  search *s = w->s;
+  const nes *state = s->states[parent];
+
+  for (size_t i = 0; i < s->o.input_count; i++) {
+    if (atomic_load(&s->full)) {
+      return;
+    }
+    nes_load_state(&w->machine, state);
+    nes_set_buttons(&w->machine, 0, s->o.inputs[i]);
+    nes_set_buttons(&w->machine, 1, 0);
+    for (uint32_t f = 0; f < s->o.frames_per_input; f++) {
+      nes_run_frame(&w->machine, NULL, 0);
+    }
+    nes_save_state(&w->machine, &w->child);
+    if (s->o.filter && !s->o.filter(&w->child, s->o.ctx)) {
+      continue;
+    }
+
+    uint64_t h = search_state_hash(&w->child);
+    if (!visit(s, h)) {
+      continue;
+    }
+    size_t index = atomic_fetch_add(&s->node_count, 1);
+    if (s->o.max_nodes <= index) {
+      atomic_store(&s->full, true);
+      return;
+    }
+
+    size_t size = encode_delta((const uint8_t *)state,
+                               (const uint8_t *)&w->child, sizeof(nes),
+                               w->delta);
+    search_node *node = &s->nodes[index];
+    node->hash = h;
+    node->parent = parent;
+    node->depth = s->nodes[parent].depth + 1;
+    node->input = s->o.inputs[i];
+    node->delta_size = size;
+    node->delta = malloc(size ? size : 1);
+    memcpy(node->delta, w->delta, size);
+
+    s->states[index] = aligned_alloc(NES_CACHE_LINE, sizeof(nes));
+    memcpy(s->states[index], &w->child, sizeof(nes));
+    s->next[atomic_fetch_add(&s->next_count, 1)] = index;
+  }
+}
+
+static void *worker_main(void *arg) {
+  worker *w = arg;
+  search *s = w->s;
+  size_t i;
+  while ((i = atomic_fetch_add(&s->cursor, 1)) < s->frontier_count) {
+    expand(w, s->frontier[i]);
+  }
+  return NULL;
+}
+
+search *search_create(const nes *root, const search_options *o) {
+  if (o->max_nodes == 0 || UINT32_MAX <= o->max_nodes || o->input_count == 0) {
+    return NULL;
+  }
+  search *s = aligned_alloc(_Alignof(search), sizeof(search));
+  if (!s) {
+    return NULL;
+  }
+  memset(s, 0, sizeof(search));
+  s->o = *o;
+  if (s->o.threads <= 0) {
+    s->o.threads = 1;
+  }
+  s->prg_rom = root->cartridge.prg_rom;
+  s->chr_rom = root->cartridge.chr_rom;
+  nes_save_state(root, &s->root);
+
+  size_t capacity = 1;
+  while (capacity < o->max_nodes * 2) {
+    capacity <<= 1;
+  }
+  s->visited_mask = capacity - 1;
+  s->visited = calloc(capacity, sizeof(uint64_t));
+  s->nodes = calloc(o->max_nodes, sizeof(search_node));
+  s->states = calloc(o->max_nodes, sizeof(nes *));
+  s->frontier = calloc(o->max_nodes, sizeof(uint32_t));
+  s->next = calloc(o->max_nodes, sizeof(uint32_t));
+  s->states[0] = aligned_alloc(NES_CACHE_LINE, sizeof(nes));
+  if (!s->visited || !s->nodes || !s->states || !s->frontier || !s->next ||
+      !s->states[0]) {
+    search_destroy(s);
+    return NULL;
+  }
+
+  memcpy(s->states[0], &s->root, sizeof(nes));
+  s->nodes[0] = (search_node){.parent = UINT32_MAX};
+  s->nodes[0].hash = search_state_hash(s->states[0]);
+  visit(s, s->nodes[0].hash);
+  atomic_store(&s->node_count, 1);
+  s->frontier[0] = 0;
+  s->frontier_count = 1;
+  return s;
+}
+
+void search_destroy(search *s) {
+  size_t count = search_node_count(s);
+  for (size_t i = 0; s->nodes && i < count; i++) {
+    free(s->nodes[i].delta);
+  }
+  for (size_t i = 0; s->states && i < count; i++) {
+    free(s->states[i]);
+  }
+  free((void *)s->visited);
+  free(s->nodes);
+  free(s->states);
+  free(s->frontier);
+  free(s->next);
+  free(s);
+}
+
+size_t search_step(search *s) {
+  if (atomic_load(&s->full) || s->frontier_count == 0) {
+    return 0;
+  }
+  size_t before = search_node_count(s);
+  atomic_store(&s->next_count, 0);
+  atomic_store(&s->cursor, 0);
+
+  int threads = s->o.threads;
+  pthread_t *ids = calloc(threads, sizeof(pthread_t));
+  worker **workers = calloc(threads, sizeof(worker *));
+  int started = 0;
+  for (; ids && workers && started < threads; started++) {
+    worker *w = aligned_alloc(_Alignof(worker), sizeof(worker));
+    if (!w) {
+      break;
+    }
+    w->s = s;
+    // the ROM only: the root's battery save and instrumentation are not
+    // shared between threads
+    nes_init(&w->machine);
+    w->machine.cartridge.prg_rom = s->prg_rom;
+    w->machine.cartridge.chr_rom = s->chr_rom;
+    nes_load_state(&w->machine, &s->root);
+    workers[started] = w;
+    if (pthread_create(&ids[started], NULL, worker_main, w) != 0) {
+      free(w);
+      break;
+    }
+  }
+  for (int i = 0; i < started; i++) {
+    pthread_join(ids[i], NULL);
+    free(workers[i]);
+  }
+  free(ids);
+  free(workers);
+  if (started == 0) {
+    return 0;
+  }
+
+  // only the new layer stays expandable
+  for (size_t i = 0; i < s->frontier_count; i++) {
+    free(s->states[s->frontier[i]]);
+    s->states[s->frontier[i]] = NULL;
+  }
+  uint32_t *frontier = s->frontier;
+  s->frontier = s->next;
+  s->next = frontier;
+  s->frontier_count = atomic_load(&s->next_count);
+  return search_node_count(s) - before;
+}
+
+size_t search_node_count(const search *s) {
+  size_t count = atomic_load(&((search *)s)->node_count);
+  return count < s->o.max_nodes ? count : s->o.max_nodes;
+}
+
+const search_node *search_get_node(const search *s, size_t index) {
+  return &s->nodes[index];
+}
+
+void search_node_state(const search *s, size_t index, nes *n) {
+  uint32_t depth = s->nodes[index].depth;
+  uint32_t *path = malloc((depth + 1) * sizeof(uint32_t));
+  nes *state = aligned_alloc(NES_CACHE_LINE, sizeof(nes));
+  for (uint32_t i = index, d = depth;; i = s->nodes[i].parent, d--) {
+    path[d] = i;
+    if (d == 0) {
+      break;
+    }
+  }
+  memcpy(state, &s->root, sizeof(nes));
+  for (uint32_t d = 1; d <= depth; d++) {
+    const search_node *node = &s->nodes[path[d]];
+    apply_delta((uint8_t *)state, node->delta, node->delta_size);
+  }
+  nes_load_state(n, state);
+  free(path);
+  free(state);
+}
@@ -0,0 +1,68 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nes.h"
+
+// State-space search over input trees
+//
+// Starting from a root state, every frontier node is branched on every input
+// in search_options.inputs, each held on port 0 for frames_per_input frames.
+// Children whose state was already visited are dropped, so the tree becomes a
+// graph of distinct states. Frontier layers are expanded in parallel.
+//
+// Time counters (CPU cycles except for their parity, and the frame number) and
+// the buttons held, which the next expansion replaces, are not part of a
+// state's identity. Stored nodes keep only a delta from their parent's state.
+// Full states are kept for the frontier only.
+
+typedef struct SearchNode {
+  uint64_t hash; // search_state_hash()
+  uint32_t parent; // UINT32_MAX for the root
+  uint32_t depth;
+  uint8_t input; // buttons held since the parent
+  uint32_t delta_size;
+  uint8_t *delta;
+} search_node;
+
+// Decide whether a new state is kept (and expanded), e.g. to prune deaths
+typedef bool (*search_filter)(const nes *state, void *ctx);
+
+typedef struct SearchOptions {
+  const uint8_t *inputs; // port 0 buttons to branch on
+  size_t input_count;
+  uint32_t frames_per_input;
+  size_t max_nodes; // capacity of the node store and the visited set
+  int threads;
+  search_filter filter; // optional
+  void *ctx;
+} search_options;
+
+typedef struct Search search;
+
+// root must have its ROM loaded; the ROM image must outlive the search. Only
+// its state and ROM are used: its battery save and instrumentation are not
+// attached to the machines of the search.
+search *search_create(const nes *root, const search_options *o);
+
+void search_destroy(search *s);
+
+// Expand the whole frontier by one layer. Returns the number of new nodes,
+// 0 once the search is exhausted or the node store is full.
+size_t search_step(search *s);
+
+size_t search_node_count(const search *s);
+
+const search_node *search_get_node(const search *s, size_t index);
+
+// nes_state_hash() of a saved state without the parts that are not its
+// identity, never 0. state is restored before returning.
+uint64_t search_state_hash(nes *state);
+
+// Rebuild the state of a node into n, which must have the ROM loaded
+void search_node_state(const search *s, size_t index, nes *n);
+
+#endif // SEARCH_H
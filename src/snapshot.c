@@ -0,0 +1,346 @@
+#include "snapshot.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hash.h"
+#include "lz.h"
+
+#define ALIGN 64 // of uncompressed chunks, enough for any part of a nes
+
+static const uint8_t magic[4] = {'X', 'S', 'N', 0x1A};
+
+typedef struct Header {
+  uint8_t magic[4];
+  uint16_t version;
+  uint16_t reserved;
+  uint32_t states;
+  uint32_t chunks;
+  uint64_t directory;
+  uint64_t rom_hash;
+  uint64_t file_size;
+  uint64_t directory_hash;
+  uint8_t reserved2[16];
+} header;
+
+typedef struct Entry {
+  uint32_t type;
+  uint16_t version;
+  uint16_t flags;
+  uint32_t state;
+  uint32_t size;
+  uint64_t offset;
+  uint32_t stored;
+  uint32_t reserved;
+  uint64_t hash;
+} entry;
+
+_Static_assert(sizeof(header) == 64 && sizeof(entry) == 40,
+               "the layout is documented in snapshot.h");
+
+// The part of a saved nes each chunk type holds. Bump the version of a type
+// whenever the layout of its part changes.
+typedef struct ChunkType {
+  snapshot_chunk_type type;
+  uint16_t version;
+  size_t offset, size;
+} chunk_type;
+
+static const chunk_type chunk_types[] = {
+    {SNAPSHOT_CPU, 1, offsetof(nes, cpu), sizeof(cpu)},
+    {SNAPSHOT_CORE, 1, offsetof(nes, interrupt),
+     offsetof(nes, read_pages) - offsetof(nes, interrupt)},
+    {SNAPSHOT_RAM, 1, offsetof(nes, ram), sizeof(((nes *)0)->ram)},
+    {SNAPSHOT_PPU, 1, offsetof(nes, ppu), sizeof(ppu)},
+    {SNAPSHOT_CARTRIDGE, 1, offsetof(nes, cartridge), sizeof(cartridge)},
+};
+
+// The sizes of the parts at the versions above, on LP64 hosts, so that a
+// layout change fails to build until the version is bumped and the size here
+// updated. Changes keeping the size still need a bump by hand.
+#if UINTPTR_MAX == UINT64_MAX
+_Static_assert(sizeof(cpu) == 24, "bump the version of SNAPSHOT_CPU");
+_Static_assert(offsetof(nes, read_pages) - offsetof(nes, interrupt) == 16,
+               "bump the version of SNAPSHOT_CORE");
+_Static_assert(sizeof(((nes *)0)->ram) == 0x800,
+               "bump the version of SNAPSHOT_RAM");
+_Static_assert(sizeof(ppu) == 2720, "bump the version of SNAPSHOT_PPU");
+_Static_assert(sizeof(cartridge) == 16440,
+               "bump the version of SNAPSHOT_CARTRIDGE");
+#endif
+
+#define CHUNK_TYPES (sizeof(chunk_types) / sizeof(chunk_types[0]))
+
+static const chunk_type *find_type(uint32_t type) {
+  for (size_t i = 0; i < CHUNK_TYPES; i++) {
+    if (chunk_types[i].type == type) {
+      return &chunk_types[i];
+    }
+  }
+  return NULL;
+}
+
+// Writing
+
+struct SnapshotWriter {
+  FILE *f;
+  uint64_t rom_hash;
+  bool compress;
+  bool ok;
+  uint64_t offset; // end of the chunks written
+  uint32_t states;
+  entry *entries;
+  size_t count, capacity;
+  nes *state;
+  uint8_t *buffer; // a compressed chunk
+};
+
+static bool pad_to(snapshot_writer *w, uint64_t offset) {
+  static const uint8_t zeros[ALIGN];
+  size_t n = offset - w->offset;
+  w->offset = offset;
+  return fwrite(zeros, 1, n, w->f) == n;
+}
+
+snapshot_writer *snapshot_create(const char *path, uint64_t rom_hash,
+                                 bool compress) {
+  snapshot_writer *w = calloc(1, sizeof(snapshot_writer));
+  if (!w) {
+    return NULL;
+  }
+  size_t largest = 0;
+  for (size_t i = 0; i < CHUNK_TYPES; i++) {
+    if (largest < chunk_types[i].size) {
+      largest = chunk_types[i].size;
+    }
+  }
+  w->f = fopen(path, "wb");
+  w->rom_hash = rom_hash;
+  w->compress = compress;
+  w->state = aligned_alloc(NES_CACHE_LINE, sizeof(nes));
+  w->buffer = malloc(largest);
+  // the header is written last
+  w->ok = w->f && w->state && w->buffer && pad_to(w, sizeof(header));
+  if (!w->ok) {
+    snapshot_finish(w);
+    return NULL;
+  }
+  return w;
+}
+
+static bool add_chunk(snapshot_writer *w, const chunk_type *t) {
+  const uint8_t *data = (const uint8_t *)w->state + t->offset;
+  entry e = {t->type, t->version, 0, w->states, t->size, 0, t->size, 0, 0};
+  if (w->compress) {
+    size_t size = lz_compress(w->buffer, t->size - 1, data, t->size);
+    if (size) {
+      data = w->buffer;
+      e.stored = size;
+      e.flags = SNAPSHOT_CHUNK_COMPRESSED;
+    }
+  }
+  // only chunks used in place need aligning
+  uint64_t offset = w->offset;
+  if (!(e.flags & SNAPSHOT_CHUNK_COMPRESSED)) {
+    offset = (offset + ALIGN - 1) / ALIGN * ALIGN;
+  }
+  if (!pad_to(w, offset) || fwrite(data, 1, e.stored, w->f) != e.stored) {
+    return false;
+  }
+  e.offset = offset;
+  e.hash = hash64_wide(data, e.stored, 0);
+  w->offset += e.stored;
+
+  if (w->count == w->capacity) {
+    size_t capacity = w->capacity ? w->capacity * 2 : 64;
+    entry *entries = realloc(w->entries, capacity * sizeof(entry));
+    if (!entries) {
+      return false;
+    }
+    w->entries = entries;
+    w->capacity = capacity;
+  }
+  w->entries[w->count++] = e;
+  return true;
+}
+
+bool snapshot_add(snapshot_writer *w, const nes *n) {
+  if (!w->ok || w->states == UINT32_MAX) {
+    return w->ok = false;
+  }
+  nes_save_state(n, w->state);
+  for (size_t i = 0; w->ok && i < CHUNK_TYPES; i++) {
+    w->ok = add_chunk(w, &chunk_types[i]);
+  }
+  w->states++;
+  return w->ok;
+}
+
+bool snapshot_finish(snapshot_writer *w) {
+  bool ok = w->ok;
+  if (ok) {
+    uint64_t directory = (w->offset + 7) / 8 * 8;
+    size_t size = w->count * sizeof(entry);
+    header h = {
+        .version = SNAPSHOT_VERSION,
+        .states = w->states,
+        .chunks = w->count,
+        .directory = directory,
+        .rom_hash = w->rom_hash,
+        .file_size = directory + size,
+        .directory_hash = hash64_wide(w->entries, size, 0),
+    };
+    memcpy(h.magic, magic, sizeof(magic));
+    ok = pad_to(w, directory) &&
+         fwrite(w->entries, 1, size, w->f) == size &&
+         fseek(w->f, 0, SEEK_SET) == 0 &&
+         fwrite(&h, 1, sizeof(h), w->f) == sizeof(h);
+  }
+  if (w->f && fclose(w->f) != 0) {
+    ok = false;
+  }
+  free(w->entries);
+  free(w->state);
+  free(w->buffer);
+  free(w);
+  return ok;
+}
+
+// Reading
+
+struct Snapshot {
+  const uint8_t *map;
+  size_t size;
+  const header *header;
+  const entry *entries;
+  uint32_t *first; // entries of state i are [first[i], first[i + 1])
+};
+
+static bool check(snapshot *s) {
+  const header *h = s->header;
+  if (memcmp(h->magic, magic, sizeof(magic)) != 0 ||
+      h->version != SNAPSHOT_VERSION || h->file_size != s->size ||
+      h->chunks < h->states || h->directory % 8 != 0 ||
+      s->size < h->directory ||
+      (s->size - h->directory) / sizeof(entry) < h->chunks ||
+      hash64_wide(s->map + h->directory, h->chunks * sizeof(entry), 0) !=
+          h->directory_hash) {
+    return false;
+  }
+  s->entries = (const entry *)(s->map + h->directory);
+  s->first = malloc(((size_t)h->states + 1) * sizeof(uint32_t));
+  if (!s->first) {
+    return false;
+  }
+  uint32_t state = 0;
+  s->first[0] = 0;
+  for (uint32_t i = 0; i < h->chunks; i++) {
+    const entry *e = &s->entries[i];
+    if (e->state < state || h->states <= e->state ||
+        e->offset < sizeof(header) || h->directory < e->offset ||
+        h->directory - e->offset < e->stored ||
+        (!(e->flags & SNAPSHOT_CHUNK_COMPRESSED) &&
+         (e->stored != e->size || e->offset % ALIGN != 0)) ||
+        hash64_wide(s->map + e->offset, e->stored, 0) != e->hash) {
+      return false;
+    }
+    while (state < e->state) {
+      s->first[++state] = i;
+    }
+  }
+  while (state < h->states) {
+    s->first[++state] = h->chunks;
+  }
+  return true;
+}
+
+snapshot *snapshot_open(const char *path) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat st;
+  void *map = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && (off_t)sizeof(header) <= st.st_size) {
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (map == MAP_FAILED) {
+    return NULL;
+  }
+  snapshot *s = calloc(1, sizeof(snapshot));
+  if (!s) {
+    munmap(map, st.st_size);
+    return NULL;
+  }
+  s->map = map;
+  s->size = st.st_size;
+  s->header = map;
+  if (!check(s)) {
+    snapshot_close(s);
+    return NULL;
+  }
+  return s;
+}
+
+void snapshot_close(snapshot *s) {
+  munmap((void *)s->map, s->size);
+  free(s->first);
+  free(s);
+}
+
+size_t snapshot_count(const snapshot *s) { return s->header->states; }
+
+uint64_t snapshot_rom_hash(const snapshot *s) { return s->header->rom_hash; }
+
+const void *snapshot_chunk(const snapshot *s, size_t state,
+                           snapshot_chunk_type type) {
+  const chunk_type *t = find_type(type);
+  if (!t || s->header->states <= state) {
+    return NULL;
+  }
+  for (uint32_t i = s->first[state]; i < s->first[state + 1]; i++) {
+    const entry *e = &s->entries[i];
+    if (e->type == type) {
+      bool usable = !(e->flags & SNAPSHOT_CHUNK_COMPRESSED) &&
+                    e->version == t->version && e->size == t->size;
+      return usable ? s->map + e->offset : NULL;
+    }
+  }
+  return NULL;
+}
+
+bool snapshot_load(const snapshot *s, size_t state, nes *n) {
+  // the cartridge chunk holds the ROM sizes, which must match n's image
+  if (s->header->states <= state ||
+      s->header->rom_hash != cartridge_hash(&n->cartridge)) {
+    return false;
+  }
+  // parts the file lacks keep the values of n
+  nes loaded;
+  nes_save_state(n, &loaded);
+  for (uint32_t i = s->first[state]; i < s->first[state + 1]; i++) {
+    const entry *e = &s->entries[i];
+    const chunk_type *t = find_type(e->type);
+    if (!t) {
+      continue; // written by a newer build
+    }
+    if (e->version != t->version || e->size != t->size) {
+      return false;
+    }
+    uint8_t *dst = (uint8_t *)&loaded + t->offset;
+    const uint8_t *src = s->map + e->offset;
+    if (!(e->flags & SNAPSHOT_CHUNK_COMPRESSED)) {
+      memcpy(dst, src, t->size);
+    } else if (!lz_decompress(dst, t->size, src, e->stored)) {
+      return false;
+    }
+  }
+  nes_load_state(n, &loaded);
+  return true;
+}
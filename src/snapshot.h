@@ -0,0 +1,105 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nes.h"
+
+// On-disk machine states
+//
+// A snapshot file holds any number of states of machines with the same ROM,
+// each split into one chunk per component. A chunk is the component in the
+// in-memory layout of the build that wrote it, at a 64-byte aligned offset,
+// so uncompressed files are used in place through mmap(): snapshot_chunk() is
+// a bounds-checked pointer cast and snapshot_load() a copy per chunk.
+// Chunks may instead be compressed with lz.h.
+//
+// Every chunk type has a version, to be bumped whenever the layout of its
+// component changes, and a state with a chunk of another version or size
+// does not load. Chunk types missing from a file keep the values of the
+// machine loaded into, and types the reader does not know are skipped, so
+// components can be added without making older or newer files unreadable.
+//
+// Like the chunks, the header and the directory are in host byte order:
+//
+//   0  4  magic "XSN\x1A"
+//   4  2  version
+//   6  2  reserved
+//   8  4  state count
+//   12 4  chunk count
+//   16 8  offset of the directory, after the chunks
+//   24 8  cartridge_hash() of the ROM
+//   32 8  file size
+//   40 8  hash64_wide() of the directory
+//   48 16 reserved
+//
+// The directory has an entry per chunk, grouped by state in order:
+//
+//   0  4  type, snapshot_chunk_type
+//   4  2  type version
+//   6  2  flags, snapshot_chunk_flags
+//   8  4  state
+//   12 4  size in memory
+//   16 8  offset of the chunk data
+//   24 4  stored size
+//   28 4  reserved
+//   32 8  hash64_wide() of the stored data
+
+#define SNAPSHOT_VERSION 1
+
+#define SNAPSHOT_TYPE(a, b, c, d)                                              \
+  ((uint32_t)(a) | (uint32_t)(b) << 8 | (uint32_t)(c) << 16 |                  \
+   (uint32_t)(d) << 24)
+
+// Parts of a saved nes
+typedef enum SnapshotChunkType {
+  SNAPSHOT_CPU = SNAPSHOT_TYPE('C', 'P', 'U', ' '),
+  SNAPSHOT_CORE = SNAPSHOT_TYPE('C', 'O', 'R', 'E'), // interrupts, controllers
+  SNAPSHOT_RAM = SNAPSHOT_TYPE('R', 'A', 'M', ' '),
+  SNAPSHOT_PPU = SNAPSHOT_TYPE('P', 'P', 'U', ' '),
+  SNAPSHOT_CARTRIDGE = SNAPSHOT_TYPE('C', 'A', 'R', 'T'),
+} snapshot_chunk_type;
+
+typedef enum SnapshotChunkFlags {
+  SNAPSHOT_CHUNK_COMPRESSED = 1 << 0,
+} snapshot_chunk_flags;
+
+typedef struct SnapshotWriter snapshot_writer;
+
+// Start writing a file for states of the ROM with cartridge_hash() rom_hash.
+// With compress, chunks are stored compressed where that makes them smaller.
+snapshot_writer *snapshot_create(const char *path, uint64_t rom_hash,
+                                 bool compress);
+
+// Append the state of n
+bool snapshot_add(snapshot_writer *w, const nes *n);
+
+// Write the directory and the header, and free w. Returns false if this or
+// any earlier write failed.
+bool snapshot_finish(snapshot_writer *w);
+
+typedef struct Snapshot snapshot;
+
+// Map a file and check its header, directory and chunk hashes. Returns NULL
+// if it cannot be read or is not a valid snapshot file.
+snapshot *snapshot_open(const char *path);
+
+void snapshot_close(snapshot *s);
+
+size_t snapshot_count(const snapshot *s);
+
+uint64_t snapshot_rom_hash(const snapshot *s);
+
+// The chunk of type of state in place, if it is stored uncompressed in the
+// version and size of this build, or NULL
+const void *snapshot_chunk(const snapshot *s, size_t state,
+                           snapshot_chunk_type type);
+
+// Load state into n, which must have the ROM loaded, as nes_load_state().
+// Returns false if n has another ROM than the file, or if a chunk has another
+// version or size, or is corrupt.
+bool snapshot_load(const snapshot *s, size_t state, nes *n);
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,153 @@
+#include "sprite_line.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SPRITE_LINE_X86
+#endif
+
+typedef uint64_t (*in_range_kernel)(const uint8_t *oam, int scanline,
+                                    int height);
+typedef void (*composite_kernel)(ppu *p);
+
+static uint8_t flags(const ppu *p, int i) {
+  return (p->sprite_priorities[i] ? SPRITE_LINE_BEHIND : 0) |
+         (p->sprite_indexes[i] == 0 ? SPRITE_LINE_ZERO : 0);
+}
+
+static uint64_t in_range_scalar(const uint8_t *oam, int scanline, int height) {
+  uint64_t mask = 0;
+  for (int i = 0; i < 64; i++) {
+    int row = scanline - oam[i * 4];
+    mask |= (uint64_t)(0 <= row && row < height) << i;
+  }
+  return mask;
+}
+
+static void composite_scalar(ppu *p) {
+  for (int x = 0; x < PPU_WIDTH; x++) {
+    uint8_t pixel = 0;
+    for (int i = 0; i < p->sprite_count; i++) {
+      int offset = x - p->sprite_x[i];
+      if (offset < 0 || 7 < offset) {
+        continue;
+      }
+      uint8_t color = (p->sprite_patterns[i] >> ((7 - offset) * 4)) & 0x0F;
+      if (color & 3) {
+        pixel = color | flags(p, i);
+        break;
+      }
+    }
+    p->sprite_line[x] = pixel;
+  }
+}
+
+#ifdef SPRITE_LINE_X86
+// OAM entries are 32-bit lanes with y in the low byte. A row is in range iff
+// min(row, height - 1) == row as unsigned, which also rules out rows < 0.
+#define IN_RANGE_KERNEL(name, isa, vec, width, load, set1, and, sub, min,      \
+                        cmpeq, movemask)                                       \
+  __attribute__((target(isa))) static uint64_t name(                           \
+      const uint8_t *oam, int scanline, int height) {                          \
+    vec low = set1(0xFF);                                                      \
+    vec line = set1(scanline);                                                 \
+    vec last = set1(height - 1);                                               \
+    uint64_t mask = 0;                                                         \
+    for (int i = 0; i < 64; i += width) {                                      \
+      vec y = and(load((const vec *)(oam + i * 4)), low);                      \
+      vec row = sub(line, y);                                                  \
+      vec m = cmpeq(min(row, last), row);                                      \
+      mask |= (uint64_t)(uint32_t)movemask(m) << i;                            \
+    }                                                                          \
+    return mask;                                                               \
+  }
+
+#define MOVEMASK_EPI32(m) _mm_movemask_ps(_mm_castsi128_ps(m))
+#define MOVEMASK256_EPI32(m) _mm256_movemask_ps(_mm256_castsi256_ps(m))
+
+IN_RANGE_KERNEL(in_range_sse41, "sse4.1", __m128i, 4, _mm_loadu_si128,
+                _mm_set1_epi32, _mm_and_si128, _mm_sub_epi32, _mm_min_epu32,
+                _mm_cmpeq_epi32, MOVEMASK_EPI32)
+IN_RANGE_KERNEL(in_range_avx2, "avx2", __m256i, 8, _mm256_loadu_si256,
+                _mm256_set1_epi32, _mm256_and_si256, _mm256_sub_epi32,
+                _mm256_min_epu32, _mm256_cmpeq_epi32, MOVEMASK256_EPI32)
+
+// Blend the rows back to front into a line with room for sprites overhanging
+// the right edge. A row is 8 bytes: the pattern nibbles, first pixel highest,
+// are split and interleaved after a byte swap.
+__attribute__((target("sse4.1"))) static void composite_sse41(ppu *p) {
+  uint8_t line[PPU_WIDTH + 8] = {0};
+  const __m128i nibble = _mm_set1_epi8(0x0F);
+  const __m128i pattern = _mm_set1_epi8(3);
+  for (int i = p->sprite_count - 1; 0 <= i; i--) {
+    __m128i v = _mm_cvtsi32_si128(__builtin_bswap32(p->sprite_patterns[i]));
+    __m128i high = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+    __m128i pixels = _mm_unpacklo_epi8(high, _mm_and_si128(v, nibble));
+    __m128i transparent =
+        _mm_cmpeq_epi8(_mm_and_si128(pixels, pattern), _mm_setzero_si128());
+    pixels = _mm_or_si128(pixels, _mm_set1_epi8((char)flags(p, i)));
+
+    uint8_t *row = line + p->sprite_x[i];
+    __m128i behind = _mm_loadl_epi64((const __m128i *)row);
+    _mm_storel_epi64((__m128i *)row,
+                     _mm_blendv_epi8(pixels, behind, transparent));
+  }
+  memcpy(p->sprite_line, line, PPU_WIDTH);
+}
+#endif
+
+static in_range_kernel in_range;
+static composite_kernel composite;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+static bool use(const char *isa) {
+  if (strcmp(isa, "scalar") == 0) {
+    in_range = in_range_scalar;
+    composite = composite_scalar;
+    return true;
+  }
+#ifdef SPRITE_LINE_X86
+  // rows are 8 bytes wide, so compositing gains nothing from AVX2
+  if (strcmp(isa, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+    in_range = in_range_avx2;
+    composite = composite_sse41;
+    return true;
+  }
+  if (strcmp(isa, "sse4.1") == 0 && __builtin_cpu_supports("sse4.1")) {
+    in_range = in_range_sse41;
+    composite = composite_sse41;
+    return true;
+  }
+#endif
+  return false;
+}
+
+static void use_best(void) {
+  if (!use("avx2") && !use("sse4.1")) {
+    use("scalar");
+  }
+}
+
+// Set the kernels before any PPU runs, as they are called from every
+// emulation thread
+__attribute__((constructor)) static void init_kernels(void) {
+#ifdef SPRITE_LINE_X86
+  __builtin_cpu_init(); // constructors may run before that of libgcc
+#endif
+  pthread_once(&kernels_once, use_best);
+}
+
+bool sprite_line_select(const char *isa) {
+  // the default is set first, so that it never replaces the kernels selected
+  pthread_once(&kernels_once, use_best);
+  return use(isa);
+}
+
+uint64_t sprite_line_in_range(const uint8_t oam[0x100], int scanline,
+                              int height) {
+  return in_range(oam, scanline, height);
+}
+
+void sprite_line_composite(ppu *p) { composite(p); }
@@ -0,0 +1,36 @@
+#ifndef SPRITE_LINE_H
+#define SPRITE_LINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ppu.h"
+
+// Per scanline sprite kernels: finding the OAM entries in range of a line and
+// compositing the rows of up to 8 sprites into ppu.sprite_line, so that
+// rendering a pixel is a lookup instead of a scan over the sprites.
+//
+// The kernels use SSE4.1 or AVX2 when the CPU has them and fall back to the
+// scalar reference otherwise, with identical output.
+
+// A sprite_line pixel: the 4-bit color (palette, pattern) of the first opaque
+// sprite, 0 if there is none, and its flags
+#define SPRITE_LINE_COLOR 0x0F
+#define SPRITE_LINE_BEHIND 0x20 // behind the background
+#define SPRITE_LINE_ZERO 0x40   // from OAM entry 0, for sprite 0 hit
+
+// Bit i is set if row scanline - y of OAM entry i is within a sprite height
+// rows tall
+uint64_t sprite_line_in_range(const uint8_t oam[0x100], int scanline,
+                              int height);
+
+// Fill p->sprite_line from p->sprite_count rows of sprite_patterns, sprite_x,
+// sprite_priorities and sprite_indexes, earlier rows in front
+void sprite_line_composite(ppu *p);
+
+// Use the kernels for isa: "avx2", "sse4.1" or "scalar". Returns false if the
+// CPU lacks it. By default the best one available is used, chosen at load
+// time; selecting another one is for tests, while no PPU runs.
+bool sprite_line_select(const char *isa);
+
+#endif // SPRITE_LINE_H
@@ -0,0 +1,129 @@
+// Checks that writes through $6000 reach the save file, that the save is
+// mapped again on re-attaching and rewritten by nes_load_state(), that
+// fork()ed children do not write into it, and that cartridges without a
+// battery are refused.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "battery.h"
+#include "bus.h"
+#include "test_util.h"
+
+// NROM-128 that increments $6000 every frame and marks $6001
+static const uint8_t program[] = {
+    // $8000 reset: enable NMI and wait
+    0x78,             // SEI
+    0xA9, 0x80,       // LDA #$80
+    0x8D, 0x00, 0x20, // STA $2000
+    0x4C, 0x06, 0x80, // JMP $8006
+    0, 0, 0, 0, 0, 0, 0,
+    // $8010 NMI
+    0xEE, 0x00, 0x60, // INC $6000
+    0xA9, 0x5A,       // LDA #$5A
+    0x8D, 0x01, 0x60, // STA $6001
+    0x40,             // RTI
+};
+
+static uint8_t rom[TEST_ROM_SIZE];
+
+static nes n;
+static nes state;
+
+static void run_frames(int frames) {
+  for (int i = 0; i < frames; i++) {
+    nes_run_frame(&n, NULL, 0);
+  }
+}
+
+// The first two bytes of the save file, or -1
+static int saved(const char *path, int offset) {
+  FILE *f = fopen(path, "rb");
+  uint8_t bytes[2];
+  bool ok = f && fread(bytes, 1, 2, f) == 2;
+  if (f) {
+    fclose(f);
+  }
+  return ok ? bytes[offset] : -1;
+}
+
+static int check(const char *path) {
+  int failures = 0;
+  build_rom(rom, program, sizeof(program), 0);
+  power_on(&n, rom);
+  if (battery_attach(&n, path) || errno != ENOTSUP) {
+    printf("attached without a battery\n");
+    failures++;
+  }
+
+  build_rom(rom, program, sizeof(program), 0x02);
+  power_on(&n, rom);
+  if (!battery_attach(&n, path)) {
+    perror(path);
+    return failures + 1;
+  }
+  run_frames(10);
+  uint8_t count = bus_peek(&n, 0x6000);
+  if (count == 0 || saved(path, 0) != count || saved(path, 1) != 0x5A) {
+    printf("$6000 %02x, saved %d\n", count, saved(path, 0));
+    failures++;
+  }
+
+  // a child writes its private copy only
+  pid_t pid = fork();
+  if (pid == 0) {
+    run_frames(5);
+    _exit(bus_peek(&n, 0x6000) == (uint8_t)(count + 5) ? 0 : 1);
+  }
+  int status;
+  if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+      WEXITSTATUS(status) != 0 || saved(path, 0) != count) {
+    printf("child wrote into the save, or failed\n");
+    failures++;
+  }
+
+  // loading a state rewrites the save
+  nes_save_state(&n, &state);
+  run_frames(3);
+  nes_load_state(&n, &state);
+  if (saved(path, 0) != count) {
+    printf("save %d after loading a state, expected %02x\n", saved(path, 0),
+           count);
+    failures++;
+  }
+
+  if (!battery_detach(&n) || n.cartridge.prg_ram[0] != count) {
+    printf("detach lost the save\n");
+    failures++;
+  }
+  run_frames(1); // into the unmapped PRG RAM only
+  if (saved(path, 0) != count) {
+    printf("written after detaching\n");
+    failures++;
+  }
+
+  power_on(&n, rom);
+  if (!battery_attach(&n, path) || bus_peek(&n, 0x6000) != count) {
+    printf("save not mapped again\n");
+    failures++;
+  }
+  battery_detach(&n);
+  printf("battery: %s\n", failures ? "failed" : "ok");
+  return failures;
+}
+
+int main(void) {
+  char path[] = "/tmp/battery_test.XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    perror(path);
+    return EXIT_FAILURE;
+  }
+  close(fd);
+  int failures = check(path);
+  unlink(path);
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
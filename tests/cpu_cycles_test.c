@@ -0,0 +1,61 @@
+// Checks that every opcode has a handler and that each one, run from RAM
+// without page crossings or taken branches, takes the cycles cpu_cycles()
+// gives it in the cycle-exact core.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cpu_decode.h"
+#include "cpu_step.h"
+#include "test_util.h"
+
+#define CODE 0x0200
+
+static const uint8_t program[] = {0x4C, 0x00, 0x80}; // JMP $8000
+static uint8_t rom[TEST_ROM_SIZE];
+static nes n;
+
+// The status with the condition of a branch opcode false: bits 7-6 select
+// N, V, C or Z, and bit 5 is the value the branch is taken on
+static uint8_t not_taken(uint8_t opcode) {
+  static const uint8_t flags[4] = {0x80, 0x40, 0x01, 0x02};
+  return opcode & 0x20 ? 0x24 : 0x24 | flags[opcode >> 6];
+}
+
+// Operands point into RAM without crossing pages: $10 is data and ($10)
+// points to $0300, absolute operands are $0310, and X and Y are 0
+static uint8_t cycles_taken(uint8_t opcode) {
+  power_on(&n, rom);
+  n.ram[CODE] = opcode;
+  n.ram[CODE + 1] = 0x10;
+  n.ram[CODE + 2] = 0x03;
+  n.ram[0x10] = 0x00;
+  n.ram[0x11] = 0x03;
+  n.cpu.A = n.cpu.X = n.cpu.Y = 0;
+  n.cpu.P = cpu_decode(opcode).mode == RELATIVE ? not_taken(opcode) : 0x24;
+  n.cpu.PC = CODE;
+  uintmax_t start = n.cpu.cycles;
+  cpu_step(&n);
+  return n.cpu.cycles - start;
+}
+
+int main(void) {
+  build_rom(rom, program, sizeof(program), 0);
+  int failures = 0;
+  for (int op = 0; op < 256; op++) {
+    if (!cpu_handler(op)) {
+      printf("$%02X: no handler\n", op);
+      failures++;
+      continue;
+    }
+    uint8_t cycles = cycles_taken(op);
+    if (cycles != cpu_cycles(op)) {
+      printf("$%02X %s: %d cycles, table %d\n", op,
+             cpu_mnemonic_name(cpu_decode(op).mnemonic), cycles,
+             cpu_cycles(op));
+      failures++;
+    }
+  }
+  printf("opcodes: %s\n", failures ? "failed" : "ok");
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
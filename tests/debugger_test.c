@@ -0,0 +1,64 @@
+// Checks that a machine stopped by breakpoints and watchpoints, and run again
+// whenever it stops, runs the same frames as one without a debugger, also
+// when a hit falls in the instruction that ends a frame.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "debugger.h"
+#include "test_util.h"
+
+#define FRAMES 100
+
+// NROM-128 polling $2002 in a loop, with an NMI handler counting frames
+static const uint8_t program[] = {
+    // $8000 reset: enable NMI and poll the status
+    0x78,             // SEI
+    0xA9, 0x80,       // LDA #$80
+    0x8D, 0x00, 0x20, // STA $2000
+    0x2C, 0x02, 0x20, // BIT $2002
+    0x4C, 0x06, 0x80, // JMP $8006
+    0, 0, 0, 0,
+    // $8010 NMI
+    0xE6, 0x00, // INC $00
+    0x40,       // RTI
+};
+
+static uint8_t rom[TEST_ROM_SIZE];
+static nes plain, debugged;
+static nes expected, actual;
+static debugger d;
+
+int main(void) {
+  build_rom(rom, program, sizeof(program), 0);
+  power_on(&plain, rom);
+  power_on(&debugged, rom);
+  debugger_attach(&debugged, &d, NULL, NULL);
+  debugger_break(&debugged, 0x8010);
+  debugger_watch(&debugged, 0x2002, 0x2002, DEBUG_READ);
+
+  int failures = 0;
+  long stops = 0;
+  for (int i = 0; i < FRAMES; i++) {
+    nes_frame p = nes_run_frame(&plain, NULL, 0);
+    nes_frame f;
+    for (f = nes_run_frame(&debugged, NULL, 0); f.stopped;
+         f = nes_run_frame(&debugged, NULL, 0)) {
+      stops++;
+    }
+    if (f.frame != p.frame) {
+      printf("frame %ju, expected %ju\n", f.frame, p.frame);
+      failures++;
+      break;
+    }
+  }
+  nes_save_state(&plain, &expected);
+  nes_save_state(&debugged, &actual);
+  if (nes_state_hash(&actual) != nes_state_hash(&expected)) {
+    printf("state differs after %d frames\n", FRAMES);
+    failures++;
+  }
+  printf("%ld stops in %d frames: %s\n", stops, FRAMES,
+         failures ? "failed" : "ok");
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,104 @@
+// Writes an NROM-128 image that draws a background, fills RAM and reports a
+// result code as the test ROMs of blargg do, so that rom_test has a ROM to
+// run in every build:
+//
+//   make_test_rom OUT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_util.h"
+
+static const uint8_t program[] = {
+    // $8000 reset
+    0x78,             // SEI
+    0xD8,             // CLD
+    0xA2, 0xFF,       // LDX #$FF
+    0x9A,             // TXS
+    0x4C, 0x20, 0x80, // JMP $8020
+    0, 0, 0, 0, 0, 0, 0, 0,
+    // $8010 NMI: count frames
+    0xE6, 0x10, // INC $10
+    0x40,       // RTI
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    // $8020 wait for the PPU to warm up
+    0x2C, 0x02, 0x20, // BIT $2002
+    0x10, 0xFB,       // BPL $8020
+    0x2C, 0x02, 0x20, // BIT $2002
+    0x10, 0xFB,       // BPL $8025
+    // background palette
+    0xA9, 0x3F,       // LDA #$3F
+    0x8D, 0x06, 0x20, // STA $2006
+    0xA9, 0x00,       // LDA #$00
+    0x8D, 0x06, 0x20, // STA $2006
+    0xA2, 0x00,       // LDX #0
+    0xBD, 0x8B, 0x80, // LDA $808B,X
+    0x8D, 0x07, 0x20, // STA $2007
+    0xE8,             // INX
+    0xE0, 0x04,       // CPX #4
+    0xD0, 0xF5,       // BNE $8036
+    // nametable and attributes at $2000: tiles 0-3 in turn
+    0xA9, 0x20,       // LDA #$20
+    0x8D, 0x06, 0x20, // STA $2006
+    0xA9, 0x00,       // LDA #$00
+    0x8D, 0x06, 0x20, // STA $2006
+    0xA0, 0x04,       // LDY #4
+    0x8A,             // TXA
+    0x29, 0x03,       // AND #3
+    0x8D, 0x07, 0x20, // STA $2007
+    0xE8,             // INX
+    0xD0, 0xF7,       // BNE $804D
+    0x88,             // DEY
+    0xD0, 0xF4,       // BNE $804D
+    // $0300-$03FF
+    0xA2, 0x00,       // LDX #0
+    0x8A,             // TXA
+    0x49, 0x5A,       // EOR #$5A
+    0x9D, 0x00, 0x03, // STA $0300,X
+    0xE8,             // INX
+    0xD0, 0xF7,       // BNE $805B
+    // result 0 after the signature DE B0 61
+    0xA9, 0xDE,       // LDA #$DE
+    0x8D, 0x01, 0x60, // STA $6001
+    0xA9, 0xB0,       // LDA #$B0
+    0x8D, 0x02, 0x60, // STA $6002
+    0xA9, 0x61,       // LDA #$61
+    0x8D, 0x03, 0x60, // STA $6003
+    0xA9, 0x00,       // LDA #0
+    0x8D, 0x00, 0x60, // STA $6000
+    // scroll to 0, enable NMI and the background
+    0x8D, 0x05, 0x20, // STA $2005
+    0x8D, 0x05, 0x20, // STA $2005
+    0xA9, 0x80,       // LDA #$80
+    0x8D, 0x00, 0x20, // STA $2000
+    0xA9, 0x0A,       // LDA #$0A
+    0x8D, 0x01, 0x20, // STA $2001
+    0x4C, 0x88, 0x80, // JMP $8088
+    // $808B palette
+    0x21, 0x16, 0x2A, 0x12,
+};
+
+static uint8_t rom[TEST_ROM_SIZE];
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s OUT\n", argv[0]);
+    return 2;
+  }
+  build_rom(rom, program, sizeof(program), 0);
+  // tiles 1-3 in colors 1-3, with rows of tile 3 alternating
+  uint8_t *chr = rom + 16 + 0x4000;
+  for (int row = 0; row < 8; row++) {
+    chr[0x10 + row] = 0xFF;
+    chr[0x28 + row] = 0xFF;
+    chr[0x30 + row] = row & 1 ? 0xFF : 0x0F;
+    chr[0x38 + row] = row & 1 ? 0x0F : 0xFF;
+  }
+  FILE *f = fopen(argv[1], "wb");
+  if (!f || fwrite(rom, 1, sizeof(rom), f) != sizeof(rom) || fclose(f) != 0) {
+    perror(argv[1]);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
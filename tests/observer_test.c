@@ -0,0 +1,74 @@
+// Checks every observer kernel the CPU supports against the scalar path on
+// random frames at several sizes, and the frame stack order.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "observer.h"
+#include "test_util.h"
+
+#define ROUNDS 200
+
+static const char *const kernels[] = {"ssse3", "avx2"};
+static const int sizes[][2] = {{84, 84}, {128, 120}, {256, 240}, {1, 1},
+                               {255, 239}, {64, 60}};
+
+static uint8_t frame[PPU_HEIGHT * PPU_WIDTH];
+static uint8_t expected[PPU_HEIGHT * PPU_WIDTH];
+static uint8_t actual[PPU_HEIGHT * PPU_WIDTH];
+
+static int check_kernels(void) {
+  int failures = 0;
+  for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+    if (!observer_select(kernels[k])) {
+      printf("%s: not supported, skipped\n", kernels[k]);
+      continue;
+    }
+    for (int round = 0; round < ROUNDS; round++) {
+      // full bytes: the kernels must ignore the bits above the index
+      for (size_t i = 0; i < sizeof(frame); i++) {
+        frame[i] = next_random();
+      }
+      const int *size = sizes[round % (sizeof(sizes) / sizeof(sizes[0]))];
+      observer o;
+      observer_init(&o, size[0], size[1], 1);
+      observer_select("scalar");
+      observer_downscale(&o, expected, frame, PPU_WIDTH);
+      observer_select(kernels[k]);
+      observer_downscale(&o, actual, frame, PPU_WIDTH);
+      if (memcmp(expected, actual, observer_size(&o)) != 0) {
+        printf("%s: %dx%d differs in round %d\n", kernels[k], size[0],
+               size[1], round);
+        failures++;
+      }
+    }
+    printf("%s: %d rounds ok\n", kernels[k], ROUNDS);
+  }
+  return failures;
+}
+
+static int check_stack(void) {
+  observer o;
+  observer_init(&o, 1, 1, 3);
+  uint8_t stack[3];
+  // a uniform frame of index i has the luminance o.gray[i]
+  memset(frame, 0x20, sizeof(frame));
+  observer_fill(&o, stack, frame, PPU_WIDTH);
+  memset(frame, 0x16, sizeof(frame));
+  observer_push(&o, stack, frame, PPU_WIDTH);
+  memset(frame, 0x0F, sizeof(frame));
+  observer_push(&o, stack, frame, PPU_WIDTH);
+  if (stack[0] != o.gray[0x20] || stack[1] != o.gray[0x16] ||
+      stack[2] != o.gray[0x0F]) {
+    printf("stack: %02x %02x %02x\n", stack[0], stack[1], stack[2]);
+    return 1;
+  }
+  printf("stack ok\n");
+  return 0;
+}
+
+int main(void) {
+  int failures = check_kernels() + check_stack();
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+// Checks every RAM search kernel the CPU supports against the comparisons
+// made address by address, on random states sharing many values.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ram_search.h"
+#include "test_util.h"
+
+#define ROUNDS 200
+#define STATES 3
+
+static const char *const kernels[] = {"scalar", "sse2", "avx2"};
+
+static nes current[STATES], previous[STATES];
+
+// Values from a small range, so that every comparison holds at some addresses
+static void randomize(nes *n) {
+  for (size_t i = 0; i < sizeof(n->ram); i++) {
+    n->ram[i] = next_random() % 4 == 0 ? next_random() : 0x7E + i % 4;
+  }
+  for (size_t i = 0; i < sizeof(n->cartridge.prg_ram); i++) {
+    n->cartridge.prg_ram[i] = next_random() % 8 + 0x7C;
+  }
+}
+
+static uint8_t byte(const nes *n, size_t index) {
+  return index < sizeof(n->ram) ? n->ram[index]
+                                 : n->cartridge.prg_ram[index - 0x800];
+}
+
+static bool holds(uint8_t a, uint8_t b, ram_search_op op) {
+  switch (op) {
+  case RAM_SEARCH_EQ:
+    return a == b;
+  case RAM_SEARCH_NE:
+    return a != b;
+  case RAM_SEARCH_LT:
+    return a < b;
+  case RAM_SEARCH_LE:
+    return a <= b;
+  case RAM_SEARCH_GT:
+    return a > b;
+  case RAM_SEARCH_GE:
+    return a >= b;
+  }
+  return false;
+}
+
+// Narrow s as ram_search_value() (previous NULL) or ram_search_compare()
+static void narrow_reference(ram_search *s, const nes *const *a,
+                             const nes *const *b, ram_search_op op,
+                             uint8_t value) {
+  for (size_t i = 0; i < RAM_SEARCH_SIZE; i++) {
+    for (int j = 0; j < STATES; j++) {
+      if (!holds(byte(a[j], i), b ? byte(b[j], i) : value, op)) {
+        s->candidates[i / 64] &= ~(1ULL << (i % 64));
+      }
+    }
+  }
+}
+
+int main(void) {
+  const nes *a[STATES], *b[STATES];
+  for (int i = 0; i < STATES; i++) {
+    nes_init(&current[i]);
+    nes_init(&previous[i]);
+    a[i] = &current[i];
+    b[i] = &previous[i];
+  }
+
+  int failures = 0;
+  for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+    if (!ram_search_select(kernels[k])) {
+      printf("%s: not supported, skipped\n", kernels[k]);
+      continue;
+    }
+    for (int round = 0; round < ROUNDS; round++) {
+      for (int i = 0; i < STATES; i++) {
+        randomize(&current[i]);
+        randomize(&previous[i]);
+      }
+      ram_search expected, actual;
+      ram_search_reset(&expected);
+      // a sparse start exercises the skipped blocks
+      for (size_t w = 0; w < RAM_SEARCH_SIZE / 64; w++) {
+        expected.candidates[w] &= next_random() % 4 ? ~0ULL : 0;
+      }
+      actual = expected;
+      ram_search_op op = next_random() % 6;
+      size_t count;
+      if (round % 2) {
+        uint8_t value = 0x7C + next_random() % 8;
+        narrow_reference(&expected, a, NULL, op, value);
+        count = ram_search_value(&actual, a, STATES, op, value);
+      } else {
+        narrow_reference(&expected, a, b, op, 0);
+        count = ram_search_compare(&actual, a, b, STATES, op);
+      }
+      if (memcmp(&expected, &actual, sizeof(expected)) != 0 ||
+          count != ram_search_count(&expected)) {
+        printf("%s: op %d differs in round %d\n", kernels[k], op, round);
+        failures++;
+      }
+    }
+    printf("%s: %d rounds ok\n", kernels[k], ROUNDS);
+  }
+
+  ram_search s;
+  memset(&s, 0, sizeof(s));
+  s.candidates[0] = 1ULL << 5;
+  s.candidates[RAM_SEARCH_SIZE / 64 - 1] = 1ULL << 63;
+  size_t first = ram_search_next(&s, 0);
+  size_t second = ram_search_next(&s, first + 1);
+  if (ram_search_address(first) != 0x0005 ||
+      ram_search_address(second) != 0x7FFF ||
+      ram_search_next(&s, second + 1) != RAM_SEARCH_SIZE) {
+    printf("next: %zx %zx\n", first, second);
+    failures++;
+  }
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
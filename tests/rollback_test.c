@@ -0,0 +1,124 @@
+// Checks that the rollback engine ends in the state of a run with every
+// input in time when the inputs of port 1 arrive late and out of order, and
+// that frames after a corrected one are predicted again.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "rollback.h"
+#include "test_util.h"
+
+#define FRAMES 600
+
+// NROM-128 whose NMI handler reads both controllers and appends the buttons
+// to a log at $0200 (port 1) and $0300 (port 0), indexed by $03, so that the
+// state depends on the input of every frame
+static const uint8_t program[] = {
+    // $8000 reset: enable NMI and wait
+    0x78,             // SEI
+    0xA9, 0x80,       // LDA #$80
+    0x8D, 0x00, 0x20, // STA $2000
+    0x4C, 0x06, 0x80, // JMP $8006
+    0, 0, 0, 0, 0, 0, 0,
+    // $8010 NMI
+    0xA9, 0x01,       // LDA #1
+    0x8D, 0x16, 0x40, // STA $4016
+    0xA9, 0x00,       // LDA #0
+    0x8D, 0x16, 0x40, // STA $4016
+    0xA2, 0x08,       // LDX #8
+    0xAD, 0x17, 0x40, // LDA $4017
+    0x4A,             // LSR A
+    0x26, 0x00,       // ROL $00
+    0xAD, 0x16, 0x40, // LDA $4016
+    0x4A,             // LSR A
+    0x26, 0x01,       // ROL $01
+    0xCA,             // DEX
+    0xD0, 0xF1,       // BNE $801C
+    0xA4, 0x03,       // LDY $03
+    0xA5, 0x00,       // LDA $00
+    0x99, 0x00, 0x02, // STA $0200,Y
+    0xA5, 0x01,       // LDA $01
+    0x99, 0x00, 0x03, // STA $0300,Y
+    0xC8,             // INY
+    0x84, 0x03,       // STY $03
+    0x40,             // RTI
+};
+
+static uint8_t rom[TEST_ROM_SIZE];
+
+static nes n;
+static nes state;
+static rollback r;
+static uint8_t inputs[FRAMES][2];
+static int arrival[FRAMES];
+
+static uint64_t state_hash(void) {
+  nes_save_state(&n, &state);
+  return nes_state_hash(&state);
+}
+
+static int check_late_inputs(int max_delay) {
+  // buttons held for a few frames, as players do
+  uint8_t held[2] = {0, 0};
+  for (int f = 0; f < FRAMES; f++) {
+    for (int port = 0; port < 2; port++) {
+      if (next_random() % 8 == 0) {
+        held[port] = next_random();
+      }
+      inputs[f][port] = held[port];
+    }
+    arrival[f] = f + next_random() % (max_delay + 1);
+  }
+
+  power_on(&n, rom);
+  for (int f = 0; f < FRAMES; f++) {
+    nes_set_buttons(&n, 0, inputs[f][0]);
+    nes_set_buttons(&n, 1, inputs[f][1]);
+    nes_run_frame(&n, NULL, 0);
+  }
+  uint64_t expected = state_hash();
+
+  power_on(&n, rom);
+  rollback_init(&r, &n);
+  for (int host = 0; host < FRAMES + max_delay; host++) {
+    // frames arriving at the same time in reverse order
+    for (int f = host; host - max_delay <= f; f--) {
+      if (0 <= f && f < FRAMES && arrival[f] == host) {
+        rollback_set_input(&r, f, 1, inputs[f][1]);
+      }
+    }
+    if (host < FRAMES) {
+      rollback_set_input(&r, host, 0, inputs[host][0]);
+      rollback_advance(&r, NULL, 0);
+    }
+  }
+  rollback_resimulate(&r);
+  uint64_t actual = state_hash();
+  printf("delay up to %d: %ju frames resimulated, %s\n", max_delay,
+         r.resimulated_frames, actual == expected ? "ok" : "differs");
+  return actual != expected;
+}
+
+static int check_prediction(void) {
+  power_on(&n, rom);
+  rollback_init(&r, &n);
+  for (int f = 0; f < 4; f++) {
+    rollback_advance(&r, NULL, 0);
+  }
+  // frames 2 and 3 were predicted from the 0 of frame 1, and have to follow
+  // its correction
+  rollback_set_input(&r, 1, 1, 0x80);
+  rollback_resimulate(&r);
+  bool repredicted = r.inputs[2][1] == 0x80 && r.inputs[3][1] == 0x80;
+  rollback_set_input(&r, 2, 1, 0x80);
+  bool ok = repredicted && r.rollback_to == UINT32_MAX;
+  printf("prediction after a correction: %s\n", ok ? "ok" : "stale");
+  return !ok;
+}
+
+int main(void) {
+  build_rom(rom, program, sizeof(program), 0);
+  int failures = check_late_inputs(ROLLBACK_FRAMES - 1) +
+                 check_late_inputs(3) + check_prediction();
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,122 @@
+// Runs a test ROM headless for a number of frames and compares what it
+// reports with golden values:
+//
+//   rom_test ROM FRAMES RESULT FRAME_HASH RAM_HASH
+//
+// RESULT is the code the test ROMs of blargg leave at $6000 (0 if passed)
+// once $6001-$6003 hold the signature DE B0 61, in hex. FRAME_HASH is the
+// hash64() of the last frame in palette indexes and RAM_HASH that of the 2KB
+// of RAM, in hex. Any of them can be - to not check it. Test ROMs are not
+// distributed with the sources, so a ROM that does not exist is skipped
+// (exit status 77).
+//
+//   rom_test -p ROM FRAMES
+//
+// prints the values of the current build as a line of golden.txt, with the
+// ROM named relative to the directory of test ROMs the build was configured
+// with (XNES_TEST_ROMS), or by its file name if it is outside of it.
+
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "hash.h"
+#include "nes.h"
+
+#define SKIP 77
+
+static nes n;
+static uint8_t fb[PPU_WIDTH * PPU_HEIGHT];
+
+// The name of the ROM at path in golden.txt: its path relative to the
+// directory of test ROMs if it is in there, else the name it gets once
+// copied there
+static const char *golden_name(const char *path) {
+  static char rom[PATH_MAX], dir[PATH_MAX];
+  if (realpath(path, rom) && realpath(XNES_TEST_ROMS, dir)) {
+    size_t len = strlen(dir);
+    if (strncmp(rom, dir, len) == 0 && rom[len] == '/') {
+      return rom + len + 1;
+    }
+  }
+  const char *slash = strrchr(path, '/');
+  return slash ? slash + 1 : path;
+}
+
+// The result code, or -1 if the ROM does not report one
+static int result_code(const uint8_t *prg_ram) {
+  static const uint8_t signature[3] = {0xDE, 0xB0, 0x61};
+  return memcmp(prg_ram + 1, signature, 3) == 0 ? prg_ram[0] : -1;
+}
+
+static bool matches(const char *expected, uint64_t actual) {
+  return strcmp(expected, "-") == 0 ||
+         strtoull(expected, NULL, 16) == actual;
+}
+
+int main(int argc, char **argv) {
+  bool print = 1 < argc && strcmp(argv[1], "-p") == 0;
+  if (argc != (print ? 4 : 6)) {
+    fprintf(stderr,
+            "usage: %s ROM FRAMES RESULT FRAME_HASH RAM_HASH\n"
+            "       %s -p ROM FRAMES\n",
+            argv[0], argv[0]);
+    return 2;
+  }
+  char **args = argv + 1 + print;
+  const char *path = args[0];
+  long frames = strtol(args[1], NULL, 10);
+
+  if (access(path, F_OK) != 0) {
+    printf("%s: not found, skipped\n", path);
+    return SKIP;
+  }
+  size_t size;
+  uint8_t *rom = read_file(path, &size);
+  nes_init(&n);
+  if (!rom || !nes_load_rom(&n, rom, size)) {
+    printf("%s: cannot load\n", path);
+    return EXIT_FAILURE;
+  }
+  nes_power_on(&n);
+  for (long i = 1; i <= frames; i++) {
+    nes_run_frame_indexed(&n, i == frames ? fb : NULL, PPU_WIDTH);
+  }
+
+  const uint8_t *prg_ram = cartridge_prg_ram(&n.cartridge);
+  int result = result_code(prg_ram);
+  uint64_t frame_hash = hash64(fb, sizeof(fb), 0);
+  uint64_t ram_hash = hash64(n.ram, sizeof(n.ram), 0);
+  if (print) {
+    char code[8] = "-";
+    if (0 <= result) {
+      snprintf(code, sizeof(code), "%02x", (uint8_t)result);
+    }
+    printf("%s %ld %s %016" PRIx64 " %016" PRIx64 "\n", golden_name(path),
+           frames, code, frame_hash, ram_hash);
+    return EXIT_SUCCESS;
+  }
+
+  int failures = 0;
+  if (strcmp(args[2], "-") != 0 &&
+      (result < 0 || !matches(args[2], result))) {
+    // the ROM's message follows the signature
+    printf("result %d, expected %s: %.*s\n", result, args[2], 0x100,
+           0 <= result ? (const char *)prg_ram + 4 : "");
+    failures++;
+  }
+  if (!matches(args[3], frame_hash)) {
+    printf("frame hash %016" PRIx64 ", expected %s\n", frame_hash, args[3]);
+    failures++;
+  }
+  if (!matches(args[4], ram_hash)) {
+    printf("RAM hash %016" PRIx64 ", expected %s\n", ram_hash, args[4]);
+    failures++;
+  }
+  free(rom);
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
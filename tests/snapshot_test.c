@@ -0,0 +1,321 @@
+// Checks LZ round trips and rejection of truncated input, and that snapshot
+// files with and without compression load back the states written, serve
+// chunks in place, are rejected when corrupt and do not load into machines
+// with another ROM. Directory entries rewritten as another build would write
+// them check the versioning of chunks: a state with a chunk of another
+// version or size does not load, and one with a chunk of an unknown type
+// loads without it, keeping the machine's values there.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "hash.h"
+#include "lz.h"
+#include "snapshot.h"
+#include "test_util.h"
+
+#define STATES 50
+
+static uint8_t data[0x10000];
+static uint8_t packed[0x11000];
+static uint8_t unpacked[0x10000];
+
+static int check_lz(void) {
+  int failures = 0;
+  for (int round = 0; round < 64; round++) {
+    // runs, repeats at random distances and noise in varying proportions
+    size_t size = next_random() % sizeof(data);
+    for (size_t i = 0; i < size; i++) {
+      uint32_t r = next_random();
+      if (r % 64 < (uint32_t)round && i) {
+        data[i] = r & 1 ? data[i - 1] : data[(r >> 8) % i];
+      } else {
+        data[i] = r >> 24;
+      }
+    }
+    size_t packed_size = lz_compress(packed, sizeof(packed), data, size);
+    if (!packed_size ||
+        !lz_decompress(unpacked, size, packed, packed_size) ||
+        memcmp(data, unpacked, size) != 0) {
+      printf("lz: round %d of %zu bytes differs\n", round, size);
+      failures++;
+    } else if (lz_decompress(unpacked, size, packed, packed_size - 1)) {
+      printf("lz: round %d accepts truncated input\n", round);
+      failures++;
+    }
+  }
+  memset(data, 0, sizeof(data));
+  size_t zeros = lz_compress(packed, sizeof(packed), data, sizeof(data));
+  if (!zeros || 300 < zeros || lz_compress(packed, 10, data, sizeof(data))) {
+    printf("lz: %zu bytes for zeros, or no capacity check\n", zeros);
+    failures++;
+  }
+  printf("lz: %s\n", failures ? "failed" : "ok");
+  return failures;
+}
+
+// Any program: states are only loaded into machines with the same ROM
+static const uint8_t program[] = {0x4C, 0x00, 0x80}; // JMP $8000
+static uint8_t rom[TEST_ROM_SIZE];
+static uint8_t other_rom[TEST_ROM_SIZE];
+static uint64_t rom_hash;
+
+static void init_machine(nes *n, const uint8_t *image) {
+  nes_init(n);
+  nes_load_rom(n, image, TEST_ROM_SIZE);
+}
+
+static void randomize(nes *n) {
+  init_machine(n, rom);
+  n->cpu.A = next_random();
+  n->cpu.PC = next_random();
+  n->cpu.cycles = next_random();
+  n->interrupt = next_random() & INTERRUPT_NMI;
+  n->controllers[1].buttons = next_random();
+  n->ppu.frame = next_random();
+  n->ppu.v = next_random();
+  for (size_t i = 0; i < sizeof(n->ram); i += 1 + next_random() % 16) {
+    n->ram[i] = next_random();
+  }
+  for (size_t i = 0; i < 16; i++) {
+    n->cartridge.prg_ram[next_random() % sizeof(n->cartridge.prg_ram)] =
+        next_random();
+  }
+}
+
+// Flip a bit of the byte at offset from whence and check that the file no
+// longer opens, then restore it
+static bool rejects_flip(const char *path, long offset, int whence) {
+  FILE *f = fopen(path, "r+b");
+  fseek(f, offset, whence);
+  int c = fgetc(f);
+  fseek(f, offset, whence);
+  fputc(c ^ 1, f);
+  fflush(f);
+  snapshot *s = snapshot_open(path);
+  fseek(f, offset, whence);
+  fputc(c, f);
+  fclose(f);
+  if (s) {
+    snapshot_close(s);
+  }
+  return !s;
+}
+
+static nes written[STATES];
+static nes loaded;
+static nes expected;
+static nes actual;
+
+static int check_file(const char *path, bool compress) {
+  const char *name = compress ? "compressed" : "uncompressed";
+  snapshot_writer *w = snapshot_create(path, rom_hash, compress);
+  for (int i = 0; i < STATES; i++) {
+    randomize(&written[i]);
+    snapshot_add(w, &written[i]);
+  }
+  if (!snapshot_finish(w)) {
+    printf("%s: cannot write %s\n", name, path);
+    return 1;
+  }
+  snapshot *s = snapshot_open(path);
+  if (!s || snapshot_count(s) != STATES || snapshot_rom_hash(s) != rom_hash) {
+    printf("%s: cannot open\n", name);
+    return 1;
+  }
+  int failures = 0;
+  for (int i = STATES - 1; 0 <= i; i--) {
+    init_machine(&loaded, rom);
+    nes_save_state(&written[i], &expected);
+    const uint8_t *ram = snapshot_chunk(s, i, SNAPSHOT_RAM);
+    if (!snapshot_load(s, i, &loaded) ||
+        (nes_save_state(&loaded, &actual),
+         nes_state_hash(&actual) != nes_state_hash(&expected)) ||
+        (compress ? ram != NULL
+                  : !ram || memcmp(ram, expected.ram, sizeof(expected.ram)))) {
+      printf("%s: state %d differs\n", name, i);
+      failures++;
+    }
+  }
+  init_machine(&loaded, other_rom);
+  if (snapshot_load(s, 0, &loaded)) {
+    printf("%s: state loaded with another ROM\n", name);
+    failures++;
+  }
+  snapshot_close(s);
+
+  // in the chunks (the RAM of the first state) and in the directory
+  if (!rejects_flip(path, 200, SEEK_SET) ||
+      !rejects_flip(path, -20, SEEK_END)) {
+    printf("%s: corrupt file opened\n", name);
+    failures++;
+  }
+  printf("%s: %s\n", name, failures ? "failed" : "ok");
+  return failures;
+}
+
+// Directory layout, see snapshot.h
+#define CHUNK_COUNT 12
+#define DIRECTORY_OFFSET 16
+#define DIRECTORY_HASH 40
+#define ENTRY_SIZE 40
+#define ENTRY_TYPE 0
+#define ENTRY_VERSION 4
+#define ENTRY_SIZE_IN_MEMORY 12
+#define ENTRY_OFFSET 16
+#define ENTRY_STORED 24
+#define ENTRY_HASH 32
+
+static uint8_t *file;
+static size_t file_size;
+
+static bool read_whole(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    return false;
+  }
+  fseek(f, 0, SEEK_END);
+  file_size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  free(file);
+  file = malloc(file_size);
+  bool ok = file && fread(file, 1, file_size, f) == file_size;
+  fclose(f);
+  return ok;
+}
+
+// The directory entry of the chunk of type of the first state
+static uint8_t *find_entry(uint32_t type) {
+  uint64_t directory;
+  uint32_t chunks;
+  memcpy(&directory, file + DIRECTORY_OFFSET, sizeof(directory));
+  memcpy(&chunks, file + CHUNK_COUNT, sizeof(chunks));
+  for (uint32_t i = 0; i < chunks; i++) {
+    uint8_t *e = file + directory + i * ENTRY_SIZE;
+    uint32_t t;
+    memcpy(&t, e + ENTRY_TYPE, sizeof(t));
+    if (t == type) {
+      return e;
+    }
+  }
+  return NULL;
+}
+
+// Write file to path with the hashes of entry e and of the directory updated
+static bool write_rehashed(const char *path, uint8_t *e) {
+  uint64_t offset, directory, h;
+  uint32_t stored, chunks;
+  memcpy(&offset, e + ENTRY_OFFSET, sizeof(offset));
+  memcpy(&stored, e + ENTRY_STORED, sizeof(stored));
+  h = hash64_wide(file + offset, stored, 0);
+  memcpy(e + ENTRY_HASH, &h, sizeof(h));
+  memcpy(&directory, file + DIRECTORY_OFFSET, sizeof(directory));
+  memcpy(&chunks, file + CHUNK_COUNT, sizeof(chunks));
+  h = hash64_wide(file + directory, (size_t)chunks * ENTRY_SIZE, 0);
+  memcpy(file + DIRECTORY_HASH, &h, sizeof(h));
+  FILE *f = fopen(path, "wb");
+  bool ok = f && fwrite(file, 1, file_size, f) == file_size;
+  if (f) {
+    ok = fclose(f) == 0 && ok;
+  }
+  return ok;
+}
+
+// Open path and load its first state into loaded, its RAM filled with fill
+// first. Returns -1 if the file does not open, else whether it loads.
+static int open_and_load(const char *path, uint8_t fill) {
+  snapshot *s = snapshot_open(path);
+  if (!s) {
+    return -1;
+  }
+  init_machine(&loaded, rom);
+  memset(loaded.ram, fill, sizeof(loaded.ram));
+  bool ok = snapshot_load(s, 0, &loaded);
+  snapshot_close(s);
+  return ok;
+}
+
+static int check_versions(const char *path) {
+  int failures = 0;
+  snapshot_writer *w = snapshot_create(path, rom_hash, false);
+  randomize(&written[0]);
+  snapshot_add(w, &written[0]);
+  if (!snapshot_finish(w) || !read_whole(path)) {
+    printf("versions: cannot write %s\n", path);
+    return 1;
+  }
+  uint8_t *ram = find_entry(SNAPSHOT_RAM);
+  uint16_t version;
+  uint32_t size;
+  memcpy(&version, ram + ENTRY_VERSION, sizeof(version));
+  memcpy(&size, ram + ENTRY_SIZE_IN_MEMORY, sizeof(size));
+
+  // a RAM chunk of the next version
+  uint16_t next = version + 1;
+  memcpy(ram + ENTRY_VERSION, &next, sizeof(next));
+  snapshot *s = NULL;
+  if (!write_rehashed(path, ram) || open_and_load(path, 0) != 0 ||
+      !(s = snapshot_open(path)) || snapshot_chunk(s, 0, SNAPSHOT_RAM)) {
+    printf("versions: chunk of another version loaded\n");
+    failures++;
+  }
+  if (s) {
+    snapshot_close(s);
+  }
+  memcpy(ram + ENTRY_VERSION, &version, sizeof(version));
+
+  // a RAM chunk of the same version but smaller, stored as such
+  uint32_t smaller = size - 1;
+  memcpy(ram + ENTRY_SIZE_IN_MEMORY, &smaller, sizeof(smaller));
+  memcpy(ram + ENTRY_STORED, &smaller, sizeof(smaller));
+  if (!write_rehashed(path, ram) || open_and_load(path, 0) != 0) {
+    printf("versions: chunk of another size loaded\n");
+    failures++;
+  }
+  memcpy(ram + ENTRY_SIZE_IN_MEMORY, &size, sizeof(size));
+  memcpy(ram + ENTRY_STORED, &size, sizeof(size));
+
+  // the RAM chunk as a type this build does not know, so RAM is missing
+  uint32_t unknown = SNAPSHOT_TYPE('N', 'E', 'W', ' ');
+  memcpy(ram + ENTRY_TYPE, &unknown, sizeof(unknown));
+  nes_save_state(&written[0], &expected);
+  if (!write_rehashed(path, ram) || open_and_load(path, 0xA5) != 1) {
+    printf("versions: chunk of an unknown type not skipped\n");
+    failures++;
+  } else {
+    nes_save_state(&loaded, &actual);
+    bool kept = true;
+    for (size_t i = 0; i < sizeof(actual.ram); i++) {
+      kept = kept && actual.ram[i] == 0xA5;
+    }
+    if (!kept || actual.cpu.PC != expected.cpu.PC ||
+        memcmp(&actual.ppu.v, &expected.ppu.v, sizeof(actual.ppu.v)) != 0) {
+      printf("versions: other chunks not loaded or RAM overwritten\n");
+      failures++;
+    }
+  }
+  printf("versions: %s\n", failures ? "failed" : "ok");
+  return failures;
+}
+
+int main(void) {
+  char path[] = "/tmp/snapshot_test.XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    perror(path);
+    return EXIT_FAILURE;
+  }
+  close(fd);
+  build_rom(rom, program, sizeof(program), 0);
+  build_rom(other_rom, program, sizeof(program), 0);
+  other_rom[16] = 0xEA; // NOP
+  init_machine(&loaded, rom);
+  rom_hash = cartridge_hash(&loaded.cartridge);
+  int failures = check_lz() + check_file(path, false) +
+                 check_file(path, true) + check_versions(path);
+  unlink(path);
+  free(file);
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,70 @@
+// Checks every sprite_line kernel the CPU supports against the scalar
+// reference on random OAM and sprite rows.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sprite_line.h"
+#include "test_util.h"
+
+#define ROUNDS 100000
+
+static const char *const kernels[] = {"sse4.1", "avx2"};
+
+static void randomize(ppu *p) {
+  memset(p, 0, sizeof(*p));
+  for (int i = 0; i < 0x100; i++) {
+    p->oam[i] = next_random();
+  }
+  p->sprite_count = next_random() % 9;
+  for (int i = 0; i < p->sprite_count; i++) {
+    // sparse patterns exercise transparency, clustered x overlap
+    p->sprite_patterns[i] = next_random() & next_random();
+    p->sprite_x[i] = next_random() % 4 == 0 ? 240 + next_random() % 16
+                                            : next_random() % 64;
+    p->sprite_priorities[i] = next_random() & 1;
+    p->sprite_indexes[i] = i == 0 ? next_random() % 2 : 1u + i;
+  }
+}
+
+int main(void) {
+  int failures = 0;
+  for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+    if (!sprite_line_select(kernels[k])) {
+      printf("%s: not supported, skipped\n", kernels[k]);
+      continue;
+    }
+    for (int round = 0; round < ROUNDS; round++) {
+      static ppu expected, actual;
+      randomize(&expected);
+      actual = expected;
+      int scanline = next_random() % 262;
+      int height = next_random() & 1 ? 16 : 8;
+
+      sprite_line_select("scalar");
+      uint64_t expected_mask =
+          sprite_line_in_range(expected.oam, scanline, height);
+      sprite_line_composite(&expected);
+      sprite_line_select(kernels[k]);
+      uint64_t actual_mask = sprite_line_in_range(actual.oam, scanline, height);
+      sprite_line_composite(&actual);
+
+      if (expected_mask != actual_mask) {
+        printf("%s: in range mask %016llx, expected %016llx\n", kernels[k],
+               (unsigned long long)actual_mask,
+               (unsigned long long)expected_mask);
+        failures++;
+      }
+      if (memcmp(expected.sprite_line, actual.sprite_line, PPU_WIDTH) != 0) {
+        printf("%s: sprite line differs in round %d\n", kernels[k], round);
+        failures++;
+      }
+      if (10 < failures) {
+        return EXIT_FAILURE;
+      }
+    }
+    printf("%s: %d rounds ok\n", kernels[k], ROUNDS);
+  }
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,30 @@
+#include "test_util.h"
+
+#include <string.h>
+
+static uint64_t seed = 0x9E3779B97F4A7C15;
+
+uint32_t next_random(void) {
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  return seed >> 32;
+}
+
+void build_rom(uint8_t rom[TEST_ROM_SIZE], const uint8_t *program,
+               size_t size, uint8_t flags6) {
+  static const uint8_t header[16] = {'N', 'E', 'S', 0x1A, 1, 1};
+  static const uint8_t vectors[6] = {0x10, 0x80, 0x00, 0x80, 0x00, 0x80};
+  uint8_t *prg = rom + 16;
+  memset(rom, 0, TEST_ROM_SIZE);
+  memcpy(rom, header, sizeof(header));
+  rom[6] = flags6;
+  memcpy(prg, program, size);
+  memcpy(prg + 0x3FFA, vectors, sizeof(vectors));
+}
+
+void power_on(nes *n, const uint8_t *rom) {
+  nes_init(n);
+  nes_load_rom(n, rom, TEST_ROM_SIZE);
+  nes_power_on(n);
+}
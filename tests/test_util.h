@@ -0,0 +1,26 @@
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nes.h"
+
+// Helpers shared by the unit tests
+
+// An iNES image of NROM-128: 16KB of PRG ROM and 8KB of CHR ROM
+#define TEST_ROM_SIZE (16 + 0x4000 + 0x2000)
+
+// Xorshift, the same sequence in every run
+uint32_t next_random(void);
+
+// Build an NROM-128 image into rom with program at $8000, where it is reset,
+// and its NMI handler at $8010. flags6 is byte 6 of the header, e.g. 0x02 for
+// a battery.
+void build_rom(uint8_t rom[TEST_ROM_SIZE], const uint8_t *program,
+               size_t size, uint8_t flags6);
+
+// Initialize n, load rom built by build_rom() and power on
+void power_on(nes *n, const uint8_t *rom);
+
+#endif // TEST_UTIL_H
@@ -0,0 +1,54 @@
+#include "common.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "movie.h"
+
+uint8_t *read_file(const char *path, size_t *size) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    return NULL;
+  }
+  fseek(f, 0, SEEK_END);
+  long len = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  uint8_t *buf = len < 0 ? NULL : malloc(len ? len : 1);
+  if (buf && fread(buf, 1, len, f) != (size_t)len) {
+    free(buf);
+    buf = NULL;
+  }
+  fclose(f);
+  *size = len;
+  return buf;
+}
+
+bool play_movie(nes *n, const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  movie_header h;
+  bool ok = movie_read_header(f, &h) &&
+            h.rom_hash == cartridge_hash(&n->cartridge);
+  if (!ok) {
+    fprintf(stderr, "%s: not a movie for this ROM\n", path);
+  } else {
+    movie_power_on(n, &h);
+    for (uint32_t i = 0; i < h.frames; i++) {
+      uint8_t buttons[2];
+      if (!movie_read_frame(f, &h, buttons)) {
+        fprintf(stderr, "%s: truncated at frame %" PRIu32 "\n", path, i);
+        ok = false;
+        break;
+      }
+      nes_set_buttons(n, 0, buttons[0]);
+      nes_set_buttons(n, 1, buttons[1]);
+      nes_run_frame(n, NULL, 0);
+    }
+  }
+  fclose(f);
+  return ok;
+}
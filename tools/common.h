@@ -0,0 +1,18 @@
+#ifndef TOOLS_COMMON_H
+#define TOOLS_COMMON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "io.h"
+#include "nes.h"
+
+// Read a whole file into a malloc'ed buffer, or return NULL
+uint8_t *read_file(const char *path, size_t *size);
+
+// Power on n, which has the ROM loaded, and run the whole input movie at path
+// without rendering. Reports errors on stderr.
+bool play_movie(nes *n, const char *path);
+
+#endif // TOOLS_COMMON_H
@@ -0,0 +1,470 @@
+// Benchmark the emulator and compare runs against stored baselines:
+//
+//   xnes-bench [-n TRIALS] [-m MS] [-o FILE] [ROM]
+//
+// times single instructions running in a loop from RAM, in ns per
+// instruction including the PPU dots they take, and, given a ROM, whole
+// frames with and without rendering, in ms per frame. Every trial runs each
+// benchmark in turn for about MS milliseconds (default 20), so that drift of
+// the machine spreads over all of them, and TRIALS trials (default 15) give
+// the samples. The samples are written as JSON to FILE, or stdout.
+//
+// Baselines are results kept in DIR (default .xnes-bench) by name:
+//
+//   xnes-bench [-b DIR] -s NAME [-i FILE | run options]
+//   xnes-bench [-b DIR] -c NAME [-t PERCENT] [-p ALPHA]
+//              [-i FILE | run options]
+//
+// -s stores the results of this run, or of the JSON file given with -i, as
+// baseline NAME. -c compares them with baseline NAME, benchmark by benchmark:
+// a change of the median beyond PERCENT (default 3) is reported when a
+// two-sided Mann-Whitney U test of the samples gives p < ALPHA (default
+// 0.01), e.g. "LDA abs,X ns/op +7.1% (p<0.001)". The exit status is 1 if a
+// benchmark got slower.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "cpu_step.h"
+#include "nes.h"
+
+#define MAX_BENCHMARKS 64
+#define MAX_TRIALS 256
+#define COPIES 64 // of the instruction per loop iteration
+
+typedef struct Benchmark {
+  char name[32];
+  char unit[16];
+  double samples[MAX_TRIALS];
+  int count;
+} benchmark;
+
+typedef struct Results {
+  benchmark items[MAX_BENCHMARKS];
+  int count;
+} results;
+
+static double seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Instructions
+
+typedef struct Instruction {
+  const char *name;
+  uint8_t bytes[3];
+  int size;
+} instruction;
+
+// Operands point into RAM: $10 and $0300 hold data, ($20) points to $0300,
+// and $0380 holds an RTS. X and Y are $10, A is 1 and Z is clear.
+static const instruction instructions[] = {
+    {"NOP", {0xEA}, 1},
+    {"LDA #imm", {0xA9, 0x01}, 2},
+    {"LDA zp", {0xA5, 0x10}, 2},
+    {"LDA abs", {0xAD, 0x00, 0x03}, 3},
+    {"LDA abs,X", {0xBD, 0x00, 0x03}, 3},
+    {"LDA (zp),Y", {0xB1, 0x20}, 2},
+    {"STA abs", {0x8D, 0x00, 0x03}, 3},
+    {"INC zp", {0xE6, 0x10}, 2},
+    {"ADC #imm", {0x69, 0x01}, 2},
+    {"ASL A", {0x0A}, 1},
+    {"BNE taken", {0xD0, 0x00}, 2},
+    {"JSR abs/RTS", {0x20, 0x80, 0x03}, 3},
+    {"LDA $2002", {0xAD, 0x02, 0x20}, 3}, // through the bus
+};
+
+#define INSTRUCTIONS (sizeof(instructions) / sizeof(instructions[0]))
+#define LOOP 0x0400
+
+static nes machine;
+
+static void load_loop(nes *n, const instruction *in) {
+  nes_init(n);
+  uint8_t *code = n->ram + LOOP;
+  for (int i = 0; i < COPIES; i++) {
+    memcpy(code, in->bytes, in->size);
+    code += in->size;
+  }
+  code[0] = 0x4C; // JMP LOOP
+  code[1] = LOOP & 0xFF;
+  code[2] = LOOP >> 8;
+  n->ram[0x20] = 0x00;
+  n->ram[0x21] = 0x03;
+  n->ram[0x380] = 0x60; // RTS
+  n->cpu.A = 1;
+  n->cpu.X = n->cpu.Y = 0x10;
+  n->cpu.S = 0xFD;
+  n->cpu.P = 0x24;
+  n->cpu.PC = LOOP;
+}
+
+static double time_instruction(const instruction *in, double duration) {
+  load_loop(&machine, in);
+  uint64_t steps = 0;
+  double start = seconds(), elapsed;
+  do {
+    for (int i = 0; i < 10000; i++) {
+      cpu_step(&machine);
+    }
+    steps += 10000;
+    elapsed = seconds() - start;
+  } while (elapsed < duration);
+  return elapsed * 1e9 / steps;
+}
+
+// Frames
+
+static nes rom_machine;
+static nes rom_start; // a minute into the ROM
+static uint8_t fb[PPU_WIDTH * PPU_HEIGHT];
+
+static double time_frames(bool render, double duration) {
+  nes_load_state(&rom_machine, &rom_start);
+  int frames = 0;
+  double start = seconds(), elapsed;
+  do {
+    nes_run_frame_indexed(&rom_machine, render ? fb : NULL, PPU_WIDTH);
+    frames++;
+    elapsed = seconds() - start;
+  } while (elapsed < duration);
+  return elapsed * 1e3 / frames;
+}
+
+static int run(results *r, const char *rom_path, int trials,
+               double duration) {
+  uint8_t *rom = NULL;
+  size_t rom_size;
+  if (rom_path) {
+    rom = read_file(rom_path, &rom_size);
+    nes_init(&rom_machine);
+    if (!rom || !nes_load_rom(&rom_machine, rom, rom_size)) {
+      fprintf(stderr, "%s: cannot load ROM\n", rom_path);
+      return 1;
+    }
+    nes_power_on(&rom_machine);
+    for (int i = 0; i < 3600; i++) {
+      nes_run_frame(&rom_machine, NULL, 0);
+    }
+    nes_save_state(&rom_machine, &rom_start);
+  }
+
+  r->count = 0;
+  for (size_t i = 0; i < INSTRUCTIONS; i++) {
+    benchmark *b = &r->items[r->count++];
+    snprintf(b->name, sizeof(b->name), "%s", instructions[i].name);
+    snprintf(b->unit, sizeof(b->unit), "ns/op");
+  }
+  for (int i = 0; rom && i < 2; i++) {
+    benchmark *b = &r->items[r->count++];
+    snprintf(b->name, sizeof(b->name), i ? "frame headless" : "frame");
+    snprintf(b->unit, sizeof(b->unit), "ms/frame");
+  }
+  for (int trial = 0; trial < trials; trial++) {
+    for (int i = 0; i < r->count; i++) {
+      double sample = (size_t)i < INSTRUCTIONS
+                          ? time_instruction(&instructions[i], duration)
+                          : time_frames((size_t)i == INSTRUCTIONS, duration);
+      r->items[i].samples[trial] = sample;
+      r->items[i].count = trial + 1;
+    }
+    fprintf(stderr, "\rtrial %d/%d", trial + 1, trials);
+  }
+  fprintf(stderr, "\n");
+  free(rom);
+  return 0;
+}
+
+// JSON
+
+static bool write_results(const results *r, const char *path) {
+  FILE *f = path ? fopen(path, "w") : stdout;
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  fprintf(f, "{\n  \"benchmarks\": [\n");
+  for (int i = 0; i < r->count; i++) {
+    const benchmark *b = &r->items[i];
+    fprintf(f, "    {\"name\": \"%s\", \"unit\": \"%s\", \"samples\": [",
+            b->name, b->unit);
+    for (int j = 0; j < b->count; j++) {
+      fprintf(f, "%s%.6g", j ? ", " : "", b->samples[j]);
+    }
+    fprintf(f, "]}%s\n", i + 1 < r->count ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+  bool ok = !ferror(f);
+  if (path && fclose(f) != 0) {
+    ok = false;
+  }
+  return ok;
+}
+
+// The string after key at p, into out
+static const char *string_field(const char *p, const char *key, char *out,
+                                size_t size) {
+  p = strstr(p, key);
+  if (!p || !(p = strchr(p + strlen(key), '"'))) {
+    return NULL;
+  }
+  const char *end = strchr(++p, '"');
+  if (!end || size <= (size_t)(end - p)) {
+    return NULL;
+  }
+  memcpy(out, p, end - p);
+  out[end - p] = '\0';
+  return end + 1;
+}
+
+// Read results as written by write_results()
+static bool read_results(results *r, const char *path) {
+  size_t size;
+  char *text = (char *)read_file(path, &size);
+  if (!text) {
+    perror(path);
+    return false;
+  }
+  char *terminated = realloc(text, size + 1);
+  if (!terminated) {
+    free(text);
+    return false;
+  }
+  text = terminated;
+  text[size] = '\0';
+  r->count = 0;
+  bool ok = true;
+  const char *p = text;
+  while (ok && strstr(p, "\"name\"")) {
+    benchmark *b = &r->items[r->count];
+    p = r->count < MAX_BENCHMARKS
+            ? string_field(p, "\"name\":", b->name, sizeof(b->name))
+            : NULL;
+    p = p ? string_field(p, "\"unit\":", b->unit, sizeof(b->unit)) : NULL;
+    p = p ? strstr(p, "\"samples\":") : NULL;
+    p = p ? strchr(p, '[') : NULL;
+    ok = p != NULL;
+    b->count = 0;
+    while (ok) {
+      p += strspn(p, "[ \n\t,");
+      if (*p == ']') {
+        break;
+      }
+      char *end;
+      double v = strtod(p, &end);
+      ok = end != p && b->count < MAX_TRIALS;
+      if (ok) {
+        b->samples[b->count++] = v;
+      }
+      p = end;
+    }
+    ok = ok && b->count != 0;
+    r->count++;
+  }
+  free(text);
+  if (!ok || r->count == 0) {
+    fprintf(stderr, "%s: not xnes-bench results\n", path);
+    return false;
+  }
+  return true;
+}
+
+// Statistics
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static double median(const benchmark *b) {
+  double sorted[MAX_TRIALS];
+  memcpy(sorted, b->samples, b->count * sizeof(double));
+  qsort(sorted, b->count, sizeof(double), compare_doubles);
+  int m = b->count / 2;
+  return b->count % 2 ? sorted[m] : (sorted[m - 1] + sorted[m]) / 2;
+}
+
+// Two-sided p-value of the Mann-Whitney U test of a against b, from the
+// normal approximation with tie and continuity corrections, which is close
+// from about 8 samples per side on
+static double mann_whitney(const benchmark *a, const benchmark *b) {
+  int n = a->count + b->count;
+  double values[2 * MAX_TRIALS];
+  memcpy(values, a->samples, a->count * sizeof(double));
+  memcpy(values + a->count, b->samples, b->count * sizeof(double));
+  double sorted[2 * MAX_TRIALS];
+  memcpy(sorted, values, n * sizeof(double));
+  qsort(sorted, n, sizeof(double), compare_doubles);
+
+  // rank sum of a, ties taking the mean of their ranks
+  double rank_sum = 0, ties = 0;
+  for (int i = 0; i < a->count; i++) {
+    int below = 0, equal = 0;
+    for (int j = 0; j < n; j++) {
+      below += sorted[j] < values[i];
+      equal += sorted[j] == values[i];
+    }
+    rank_sum += below + (equal + 1) / 2.0;
+  }
+  for (int i = 0; i < n;) {
+    int t = 1;
+    while (i + t < n && sorted[i + t] == sorted[i]) {
+      t++;
+    }
+    ties += (double)t * t * t - t;
+    i += t;
+  }
+
+  double na = a->count, nb = b->count;
+  double u = rank_sum - na * (na + 1) / 2;
+  double variance = na * nb / 12 * ((n + 1) - ties / ((double)n * (n - 1)));
+  if (variance <= 0) {
+    return 1;
+  }
+  double z = fmax(fabs(u - na * nb / 2) - 0.5, 0) / sqrt(variance);
+  return erfc(z / sqrt(2));
+}
+
+static int compare(const results *baseline, const results *current,
+                   double threshold, double alpha) {
+  int regressions = 0;
+  for (int i = 0; i < current->count; i++) {
+    const benchmark *b = &current->items[i];
+    const benchmark *base = NULL;
+    for (int j = 0; j < baseline->count; j++) {
+      if (strcmp(baseline->items[j].name, b->name) == 0 &&
+          strcmp(baseline->items[j].unit, b->unit) == 0) {
+        base = &baseline->items[j];
+      }
+    }
+    if (!base) {
+      printf("%s %s: not in the baseline\n", b->name, b->unit);
+      continue;
+    }
+    double before = median(base), after = median(b);
+    double change = (after / before - 1) * 100;
+    double p = mann_whitney(b, base);
+    char p_text[16];
+    if (p < 0.001) {
+      snprintf(p_text, sizeof(p_text), "p<0.001");
+    } else if (p < 0.01) {
+      snprintf(p_text, sizeof(p_text), "p<0.01");
+    } else {
+      snprintf(p_text, sizeof(p_text), "p=%.2f", p);
+    }
+    const char *verdict = "";
+    if (p < alpha && threshold < fabs(change)) {
+      verdict = change < 0 ? "  faster" : "  REGRESSION";
+      regressions += 0 < change;
+    }
+    printf("%s %s %+.1f%% (%s) %.4g -> %.4g%s\n", b->name, b->unit, change,
+           p_text, before, after, verdict);
+  }
+  return regressions;
+}
+
+// Baselines
+
+static char *baseline_path(const char *dir, const char *name) {
+  size_t size = strlen(dir) + strlen(name) + 7;
+  char *path = malloc(size);
+  snprintf(path, size, "%s/%s.json", dir, name);
+  return path;
+}
+
+int main(int argc, char **argv) {
+  int trials = 15;
+  double duration = 0.02;
+  const char *out_path = NULL;
+  const char *in_path = NULL;
+  const char *dir = ".xnes-bench";
+  const char *save = NULL;
+  const char *against = NULL;
+  double threshold = 3;
+  double alpha = 0.01;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:m:o:i:b:s:c:t:p:")) != -1) {
+    switch (opt) {
+    case 'n':
+      trials = atoi(optarg);
+      break;
+    case 'm':
+      duration = atof(optarg) / 1e3;
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    case 'i':
+      in_path = optarg;
+      break;
+    case 'b':
+      dir = optarg;
+      break;
+    case 's':
+      save = optarg;
+      break;
+    case 'c':
+      against = optarg;
+      break;
+    case 't':
+      threshold = atof(optarg);
+      break;
+    case 'p':
+      alpha = atof(optarg);
+      break;
+    default:
+      goto usage;
+    }
+  }
+  if (trials < 2 || MAX_TRIALS < trials || duration <= 0 ||
+      argc - optind > 1 || (in_path && optind < argc)) {
+    goto usage;
+  }
+
+  static results current, baseline;
+  if (in_path ? !read_results(&current, in_path)
+              : run(&current, optind < argc ? argv[optind] : NULL, trials,
+                    duration) != 0) {
+    return 1;
+  }
+  if (!in_path && (out_path || (!save && !against)) &&
+      !write_results(&current, out_path)) {
+    return 1;
+  }
+  if (save) {
+    char *path = baseline_path(dir, save);
+    mkdir(dir, 0777);
+    bool ok = write_results(&current, path);
+    free(path);
+    if (!ok) {
+      return 1;
+    }
+  }
+  if (against) {
+    char *path = baseline_path(dir, against);
+    bool ok = read_results(&baseline, path);
+    free(path);
+    if (!ok) {
+      return 1;
+    }
+    return compare(&baseline, &current, threshold, alpha) ? 1 : 0;
+  }
+  return 0;
+
+usage:
+  fprintf(stderr,
+          "usage: %s [-n TRIALS] [-m MS] [-o FILE] [ROM]\n"
+          "       %s [-b DIR] -s NAME [-i FILE | run options]\n"
+          "       %s [-b DIR] -c NAME [-t PERCENT] [-p ALPHA] "
+          "[-i FILE | run options]\n",
+          argv[0], argv[0], argv[0]);
+  return 2;
+}
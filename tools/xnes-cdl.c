@@ -0,0 +1,132 @@
+// Log code and data of a ROM while replaying a movie, and list a log as a
+// disassembly of the code it found:
+//
+//   xnes-cdl ROM MOVIE CDL
+//   xnes-cdl -l ROM CDL
+//
+// The first form extends CDL if it exists and prints how many PRG bytes are
+// known to be code or data. The listing disassembles logged code runs,
+// prints logged data as .byte and skips unlogged bytes.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "cdl.h"
+#include "common.h"
+#include "cpu_disasm.h"
+#include "nes.h"
+
+static nes n;
+static cdl logger;
+
+// CPU address a PRG ROM byte was logged at
+static uint16_t address(const uint8_t *log, size_t i) {
+  return 0x8000 | (log[i] & CDL_BANK) << 11 | (i & 0x1FFF);
+}
+
+static void list(const uint8_t *log, size_t size) {
+  const uint8_t *prg = n.cartridge.prg_rom;
+  size_t unlogged = 0;
+  for (size_t i = 0; i < size;) {
+    if (!(log[i] & (CDL_CODE | CDL_DATA))) {
+      unlogged++;
+      i++;
+      continue;
+    }
+    if (unlogged) {
+      printf("; %zu unlogged bytes\n", unlogged);
+      unlogged = 0;
+    }
+    uint16_t pc = address(log, i);
+    uint8_t length = cpu_instruction_length(prg[i]);
+    if ((log[i] & CDL_CODE) && i + length <= size) {
+      char buf[64];
+      cpu_disassemble(pc, &prg[i], buf, sizeof(buf));
+      printf("%04X  %s\n", pc, buf);
+      i += length;
+    } else {
+      printf("%04X  .byte $%02X\n", pc, prg[i]);
+      i++;
+    }
+  }
+  if (unlogged) {
+    printf("; %zu unlogged bytes\n", unlogged);
+  }
+}
+
+int main(int argc, char **argv) {
+  bool listing = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "l")) != -1) {
+    switch (opt) {
+    case 'l':
+      listing = true;
+      break;
+    default:
+      goto usage;
+    }
+  }
+  if (argc - optind != (listing ? 2 : 3)) {
+    goto usage;
+  }
+
+  const char *rom_path = argv[optind];
+  const char *cdl_path = argv[argc - 1];
+  size_t rom_size;
+  uint8_t *rom = read_file(rom_path, &rom_size);
+  if (!rom) {
+    perror(rom_path);
+    return 1;
+  }
+  nes_init(&n);
+  if (!nes_load_rom(&n, rom, rom_size)) {
+    fprintf(stderr, "%s: unsupported ROM\n", rom_path);
+    return 1;
+  }
+  size_t size = cdl_size(&n.cartridge);
+  uint8_t *log = calloc(size, 1);
+  FILE *f = fopen(cdl_path, "rb");
+  if (f) {
+    if (!cdl_read(f, log, size)) {
+      fprintf(stderr, "%s: not a log for this ROM\n", cdl_path);
+      return 1;
+    }
+    fclose(f);
+  } else if (listing) {
+    perror(cdl_path);
+    return 1;
+  }
+
+  if (listing) {
+    list(log, n.cartridge.prg_rom_size);
+    return 0;
+  }
+
+  cdl_attach(&n, &logger, log);
+  if (!play_movie(&n, argv[optind + 1])) {
+    return 1;
+  }
+  f = fopen(cdl_path, "wb");
+  if (!f || !cdl_write(f, log, size) || fclose(f)) {
+    perror(cdl_path);
+    return 1;
+  }
+  size_t code = 0, data = 0;
+  for (size_t i = 0; i < n.cartridge.prg_rom_size; i++) {
+    code += (log[i] & CDL_CODE) != 0;
+    data += (log[i] & CDL_DATA) != 0;
+  }
+  printf("code %zu data %zu of %zu PRG bytes\n", code, data,
+         n.cartridge.prg_rom_size);
+  free(log);
+  free(rom);
+  return 0;
+
+usage:
+  fprintf(stderr,
+          "usage: %s ROM MOVIE CDL\n"
+          "       %s -l ROM CDL\n",
+          argv[0], argv[0]);
+  return 2;
+}
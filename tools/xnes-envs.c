@@ -0,0 +1,149 @@
+// Steps a batch of environments with random actions and reports throughput:
+//
+//   xnes-envs [-n ENVS] [-j THREADS] [-k FRAMES] [-e EPISODE] [-s STEPS]
+//             [-r | -g WxHxSTACK] ROM
+//
+// Every step holds a random input for FRAMES frames (default 4) on each of
+// ENVS machines (default 64). Episodes end after EPISODE steps (default 100)
+// with a reward of 1 per step. Observations are pixels, RAM with -r, or
+// stacks of grayscale frames downscaled to W x H with -g, e.g. -g 84x84x4.
+// The output is "STEPS/S FRAMES/S HASH", where HASH covers the last
+// observations and does not depend on THREADS.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "envs.h"
+#include "hash.h"
+#include "nes.h"
+
+typedef struct Episodes {
+  uint32_t length;
+  uint32_t *steps; // per env
+} episodes;
+
+static nes n;
+
+static double seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static float reward(const nes *machine, size_t env, bool *done, void *ctx) {
+  (void)machine;
+  episodes *e = ctx;
+  if (++e->steps[env] == e->length) {
+    e->steps[env] = 0;
+    *done = true;
+  }
+  return 1;
+}
+
+int main(int argc, char **argv) {
+  episodes ep = {.length = 100};
+  envs_options o = {
+      .count = 64,
+      .frames_per_step = 4,
+      .observation = ENVS_OBSERVE_PIXELS,
+      .threads = 1,
+      .reward = reward,
+      .ctx = &ep,
+  };
+  long steps = 100;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:j:k:e:s:rg:")) != -1) {
+    switch (opt) {
+    case 'n':
+      o.count = strtoul(optarg, NULL, 10);
+      break;
+    case 'j':
+      o.threads = atoi(optarg);
+      break;
+    case 'k':
+      o.frames_per_step = strtoul(optarg, NULL, 10);
+      break;
+    case 'e':
+      ep.length = strtoul(optarg, NULL, 10);
+      break;
+    case 's':
+      steps = strtol(optarg, NULL, 10);
+      break;
+    case 'r':
+      o.observation = ENVS_OBSERVE_RAM;
+      break;
+    case 'g':
+      o.observation = ENVS_OBSERVE_GRAYSCALE;
+      if (sscanf(optarg, "%dx%dx%d", &o.width, &o.height, &o.stack) != 3) {
+        goto usage;
+      }
+      break;
+    default:
+      goto usage;
+    }
+  }
+  if (argc - optind != 1 || o.count == 0 || o.threads <= 0 ||
+      o.frames_per_step == 0 || ep.length == 0) {
+    goto usage;
+  }
+
+  size_t rom_size;
+  uint8_t *rom = read_file(argv[optind], &rom_size);
+  if (!rom) {
+    perror(argv[optind]);
+    return 1;
+  }
+  nes_init(&n);
+  if (!nes_load_rom(&n, rom, rom_size)) {
+    fprintf(stderr, "%s: unsupported ROM\n", argv[optind]);
+    return 1;
+  }
+  nes_power_on(&n);
+
+  ep.steps = calloc(o.count, sizeof(uint32_t));
+  envs *e = envs_create(&n, &o);
+  size_t obs_size = o.count * (e ? envs_observation_size(e) : 0);
+  uint8_t *obs = malloc(obs_size);
+  uint8_t *actions = malloc(o.count);
+  float *rewards = malloc(o.count * sizeof(float));
+  bool *dones = malloc(o.count * sizeof(bool));
+  if (!ep.steps || !e || !obs || !actions || !rewards || !dones) {
+    fprintf(stderr, "cannot allocate %zu environments\n", o.count);
+    return 1;
+  }
+
+  envs_reset(e, obs);
+  uint32_t seed = 1;
+  double start = seconds();
+  for (long s = 0; s < steps; s++) {
+    for (size_t i = 0; i < o.count; i++) {
+      seed = seed * 1103515245 + 12345;
+      actions[i] = seed >> 24;
+    }
+    envs_step(e, actions, obs, rewards, dones);
+  }
+  double elapsed = seconds() - start;
+  double env_steps = (double)steps * o.count;
+  printf("%.0f %.0f %016" PRIx64 "\n", env_steps / elapsed,
+         env_steps * o.frames_per_step / elapsed, hash64(obs, obs_size, 0));
+
+  envs_destroy(e);
+  free(ep.steps);
+  free(obs);
+  free(actions);
+  free(rewards);
+  free(dones);
+  free(rom);
+  return 0;
+
+usage:
+  fprintf(stderr,
+          "usage: %s [-n ENVS] [-j THREADS] [-k FRAMES] [-e EPISODE] "
+          "[-s STEPS] [-r | -g WxHxSTACK] ROM\n",
+          argv[0]);
+  return 2;
+}
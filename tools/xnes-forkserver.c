@@ -0,0 +1,203 @@
+// Boot a ROM once and serve short jobs from the booted machine, forking one
+// worker process per job so the boot sequence is never repeated:
+//
+//   xnes-forkserver [-f FRAMES] SOCKET ROM
+//
+// The server powers on, runs FRAMES frames (default 0, i.e. right after
+// reset) and listens on the UNIX socket SOCKET. Every connection is handled
+// by a fork()ed child sharing the booted machine and the ROM copy-on-write.
+//
+// A job is a uint32_t frame count followed by two bytes of buttons (port 0,
+// port 1) per frame, in host byte order. The reply is the RAM hash and the
+// hash of the last frame (palette indices) as two uint64_t.
+//
+// The same tool is a client sending the inputs on stdin as a job COUNT times
+// and printing the reply and the jobs per second:
+//
+//   xnes-forkserver -c [-n COUNT] SOCKET < INPUTS
+
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "hash.h"
+#include "nes.h"
+
+static nes n;
+static uint8_t fb[PPU_WIDTH * PPU_HEIGHT];
+
+static bool socket_address(const char *path, struct sockaddr_un *addr) {
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  if (sizeof(addr->sun_path) <= strlen(path)) {
+    fprintf(stderr, "%s: socket path too long\n", path);
+    return false;
+  }
+  strcpy(addr->sun_path, path);
+  return true;
+}
+
+static void run_job(int fd) {
+  uint32_t frames;
+  if (!read_full(fd, &frames, sizeof(frames))) {
+    return;
+  }
+  for (uint32_t i = 1; i <= frames; i++) {
+    uint8_t buttons[2];
+    if (!read_full(fd, buttons, sizeof(buttons))) {
+      return;
+    }
+    nes_set_buttons(&n, 0, buttons[0]);
+    nes_set_buttons(&n, 1, buttons[1]);
+    nes_run_frame_indexed(&n, i == frames ? fb : NULL, PPU_WIDTH);
+  }
+  uint64_t reply[2] = {hash64(n.ram, sizeof(n.ram), 0),
+                       hash64(fb, sizeof(fb), 0)};
+  write_full(fd, reply, sizeof(reply));
+}
+
+static int serve(const char *path, const char *rom_path, long boot_frames) {
+  size_t rom_size;
+  uint8_t *rom = read_file(rom_path, &rom_size);
+  if (!rom) {
+    perror(rom_path);
+    return 1;
+  }
+  nes_init(&n);
+  if (!nes_load_rom(&n, rom, rom_size)) {
+    fprintf(stderr, "%s: unsupported ROM\n", rom_path);
+    return 1;
+  }
+  nes_power_on(&n);
+  for (long i = 0; i < boot_frames; i++) {
+    nes_run_frame(&n, NULL, 0);
+  }
+
+  struct sockaddr_un addr;
+  if (!socket_address(path, &addr)) {
+    return 1;
+  }
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(path);
+  if (listener < 0 || bind(listener, (struct sockaddr *)&addr, sizeof(addr)) ||
+      listen(listener, SOMAXCONN)) {
+    perror(path);
+    return 1;
+  }
+  signal(SIGCHLD, SIG_IGN); // reap workers automatically
+
+  for (;;) {
+    int fd = accept(listener, NULL, NULL);
+    if (fd < 0) {
+      continue;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+      close(listener);
+      run_job(fd);
+      _exit(0);
+    }
+    if (pid < 0) {
+      perror("fork");
+    }
+    close(fd);
+  }
+}
+
+static double seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int client(const char *path, long count) {
+  uint8_t *job = NULL;
+  size_t size = sizeof(uint32_t);
+  size_t capacity = size;
+  for (;;) {
+    if (size == capacity) {
+      capacity *= 2;
+      job = realloc(job, capacity);
+      if (!job) {
+        perror("realloc");
+        return 1;
+      }
+    }
+    size_t r = fread(job + size, 1, capacity - size, stdin);
+    if (r == 0) {
+      break;
+    }
+    size += r;
+  }
+  uint32_t frames = (size - sizeof(uint32_t)) / 2;
+  memcpy(job, &frames, sizeof(frames));
+  size = sizeof(uint32_t) + frames * 2;
+
+  struct sockaddr_un addr;
+  if (!socket_address(path, &addr)) {
+    return 1;
+  }
+  uint64_t reply[2];
+  double start = seconds();
+  for (long i = 0; i < count; i++) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+      perror(path);
+      return 1;
+    }
+    if (!write_full(fd, job, size) || !read_full(fd, reply, sizeof(reply))) {
+      fprintf(stderr, "%s: job failed\n", path);
+      return 1;
+    }
+    close(fd);
+  }
+  double elapsed = seconds() - start;
+  printf("%" PRIu32 " %016" PRIx64 " %016" PRIx64 "\n", frames, reply[0],
+         reply[1]);
+  fprintf(stderr, "%ld jobs in %.3f s, %.0f jobs/s\n", count, elapsed,
+          count / elapsed);
+  free(job);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  bool is_client = false;
+  long boot_frames = 0;
+  long count = 1;
+  int opt;
+  while ((opt = getopt(argc, argv, "cf:n:")) != -1) {
+    switch (opt) {
+    case 'c':
+      is_client = true;
+      break;
+    case 'f':
+      boot_frames = strtol(optarg, NULL, 10);
+      break;
+    case 'n':
+      count = strtol(optarg, NULL, 10);
+      break;
+    default:
+      goto usage;
+    }
+  }
+  if (is_client && argc - optind == 1 && 0 < count) {
+    return client(argv[optind], count);
+  }
+  if (!is_client && argc - optind == 2 && 0 <= boot_frames) {
+    return serve(argv[optind], argv[optind + 1], boot_frames);
+  }
+
+usage:
+  fprintf(stderr,
+          "usage: %s [-f FRAMES] SOCKET ROM\n"
+          "       %s -c [-n COUNT] SOCKET < INPUTS\n",
+          argv[0], argv[0]);
+  return 2;
+}
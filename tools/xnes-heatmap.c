@@ -0,0 +1,54 @@
+// Count bus accesses per address while replaying a movie:
+//
+//   xnes-heatmap ROM MOVIE OUT
+//
+// Writes OUT.ppm, a 256x256 image with one pixel per CPU address (writes red,
+// reads green), and OUT.json with totals per page and per I/O register.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "heatmap.h"
+#include "nes.h"
+
+static nes n;
+static heatmap h;
+
+static bool write(const char *out, const char *ext,
+                  bool (*write_heatmap)(FILE *, const heatmap *)) {
+  char path[4096];
+  snprintf(path, sizeof(path), "%s.%s", out, ext);
+  FILE *f = fopen(path, "wb");
+  if (!f || !write_heatmap(f, &h) || fclose(f)) {
+    perror(path);
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  if (argc != 4) {
+    fprintf(stderr, "usage: %s ROM MOVIE OUT\n", argv[0]);
+    return 2;
+  }
+  size_t rom_size;
+  uint8_t *rom = read_file(argv[1], &rom_size);
+  if (!rom) {
+    perror(argv[1]);
+    return 1;
+  }
+  nes_init(&n);
+  if (!nes_load_rom(&n, rom, rom_size)) {
+    fprintf(stderr, "%s: unsupported ROM\n", argv[1]);
+    return 1;
+  }
+  heatmap_attach(&n, &h);
+  if (!play_movie(&n, argv[2])) {
+    return 1;
+  }
+  bool ok = write(argv[3], "ppm", heatmap_write_ppm) &&
+            write(argv[3], "json", heatmap_write_json);
+  free(rom);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+// Headless recorder: run a ROM and dump raw video and PCM for offline
+// encoding, e.g.
+//
+//   xnes-record game.nes 3600 - audio.pcm |
+//     ffmpeg -f rawvideo -pix_fmt bgr0 -s 256x240 -r 60.0988 -i - out.mp4
+//
+// With -t pixels are drawn on a render thread while the next frame runs.
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "nes.h"
+#include "recorder.h"
+#include "render_thread.h"
+
+#define CPU_HZ 1789773
+#define AUDIO_RATE 44100
+#define POOL_SIZE 8
+// frames behind the render thread: the one being drawn, the one being copied
+// and the one drawn in between
+#define RENDER_FRAMES 3
+
+static int open_output(const char *path) {
+  if (strcmp(path, "-") == 0) {
+    return STDOUT_FILENO;
+  }
+  return open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+}
+
+// Copy the oldest frame drawn by t into f and submit it. Taking every frame
+// keeps the render thread from dropping any.
+static void submit_rendered(recorder *r, render_thread *t, recorder_frame *f) {
+  if (!f) {
+    return;
+  }
+  uintmax_t frame;
+  const uint32_t *video = render_thread_wait(t, &frame);
+  memcpy(f->video, video, PPU_WIDTH * PPU_HEIGHT * sizeof(uint32_t));
+  render_thread_release(t);
+  recorder_submit(r, f);
+}
+
+int main(int argc, char **argv) {
+  bool threaded = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "t")) != -1) {
+    if (opt != 't') {
+      goto usage;
+    }
+    threaded = true;
+  }
+  argc -= optind;
+  argv += optind;
+  if (argc < 3) {
+  usage:
+    fprintf(stderr, "usage: xnes-record [-t] ROM FRAMES VIDEO|- [AUDIO]\n");
+    return 2;
+  }
+  size_t rom_size;
+  uint8_t *rom = read_file(argv[0], &rom_size);
+  long frames = strtol(argv[1], NULL, 10);
+  int video_fd = open_output(argv[2]);
+  int audio_fd = argc < 4 ? -1 : open_output(argv[3]);
+  if (!rom || video_fd < 0 || (argc >= 4 && audio_fd < 0)) {
+    perror("xnes-record");
+    return 1;
+  }
+
+  static nes n;
+  nes_init(&n);
+  if (!nes_load_rom(&n, rom, rom_size)) {
+    fprintf(stderr, "xnes-record: unsupported ROM %s\n", argv[0]);
+    return 1;
+  }
+  nes_power_on(&n);
+
+  // an encoder exiting early makes the recorder fail instead of killing us
+  signal(SIGPIPE, SIG_IGN);
+  recorder *r = recorder_open(video_fd, audio_fd, POOL_SIZE);
+  render_thread *t = threaded ? render_thread_open(&n, RENDER_FRAMES) : NULL;
+  if (!r || (threaded && !t)) {
+    fprintf(stderr, "xnes-record: failed to start recorder\n");
+    return 1;
+  }
+
+  // There is no APU yet, so the audio stream is silence paced by CPU cycles
+  // to keep it in sync with the video.
+  uintmax_t audio_clock = 0;
+  recorder_frame *pending = NULL;
+  for (long i = 0; i < frames; i++) {
+    recorder_frame *f = recorder_acquire(r);
+    nes_frame result = t ? render_thread_run_frame(t)
+                         : nes_run_frame(&n, f->video, PPU_WIDTH);
+
+    audio_clock += result.cycles * AUDIO_RATE;
+    f->audio_samples = audio_clock / CPU_HZ;
+    audio_clock %= CPU_HZ;
+    if (RECORDER_AUDIO_CAPACITY < f->audio_samples) {
+      f->audio_samples = RECORDER_AUDIO_CAPACITY;
+    }
+    memset(f->audio, 0, f->audio_samples * sizeof(int16_t));
+
+    if (t) {
+      // the previous frame has been drawn while this one ran
+      submit_rendered(r, t, pending);
+      pending = f;
+    } else {
+      recorder_submit(r, f);
+    }
+  }
+
+  if (t) {
+    submit_rendered(r, t, pending);
+    render_thread_close(t);
+  }
+  bool ok = recorder_close(r);
+  free(rom);
+  if (!ok) {
+    fprintf(stderr, "xnes-record: write failed\n");
+    return 1;
+  }
+  return 0;
+}
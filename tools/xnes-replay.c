@@ -0,0 +1,106 @@
+// Replay input movies headless as fast as possible and print RAM and frame
+// hashes at checkpoints:
+//
+//   xnes-replay [-i INTERVAL] ROM MOVIE...
+//
+// Each output line is "MOVIE FRAME RAM_HASH FRAME_HASH". A checkpoint is
+// every INTERVAL frames (default 600) and the last frame. Only checkpoint
+// frames are rendered.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "hash.h"
+#include "movie.h"
+#include "nes.h"
+
+static nes n;
+static uint8_t fb[PPU_WIDTH * PPU_HEIGHT];
+static char movie_buffer[1 << 16];
+
+static bool replay(const char *path, const uint8_t *rom, size_t rom_size,
+                   long interval) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  setvbuf(f, movie_buffer, _IOFBF, sizeof(movie_buffer));
+
+  bool ok = false;
+  movie_header h;
+  nes_init(&n);
+  nes_load_rom(&n, rom, rom_size);
+  if (!movie_read_header(f, &h)) {
+    fprintf(stderr, "%s: not a movie\n", path);
+  } else if (h.rom_hash != cartridge_hash(&n.cartridge)) {
+    fprintf(stderr, "%s: recorded for another ROM\n", path);
+  } else {
+    movie_power_on(&n, &h);
+    ok = true;
+    for (uint32_t i = 1; i <= h.frames; i++) {
+      uint8_t buttons[2];
+      if (!movie_read_frame(f, &h, buttons)) {
+        fprintf(stderr, "%s: truncated at frame %" PRIu32 "\n", path, i);
+        ok = false;
+        break;
+      }
+      nes_set_buttons(&n, 0, buttons[0]);
+      nes_set_buttons(&n, 1, buttons[1]);
+
+      bool checkpoint = i % interval == 0 || i == h.frames;
+      nes_run_frame_indexed(&n, checkpoint ? fb : NULL, PPU_WIDTH);
+      if (checkpoint) {
+        printf("%s %" PRIu32 " %016" PRIx64 " %016" PRIx64 "\n", path, i,
+               hash64(n.ram, sizeof(n.ram), 0), hash64(fb, sizeof(fb), 0));
+      }
+    }
+  }
+  fclose(f);
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  long interval = 600;
+  int opt;
+  while ((opt = getopt(argc, argv, "i:")) != -1) {
+    switch (opt) {
+    case 'i':
+      interval = strtol(optarg, NULL, 10);
+      break;
+    default:
+      goto usage;
+    }
+  }
+  if (argc - optind < 2 || interval <= 0) {
+    goto usage;
+  }
+
+  size_t rom_size;
+  uint8_t *rom = read_file(argv[optind], &rom_size);
+  if (!rom) {
+    perror(argv[optind]);
+    return 1;
+  }
+  nes_init(&n);
+  if (!nes_load_rom(&n, rom, rom_size)) {
+    fprintf(stderr, "%s: unsupported ROM\n", argv[optind]);
+    return 1;
+  }
+
+  int failures = 0;
+  for (int i = optind + 1; i < argc; i++) {
+    if (!replay(argv[i], rom, rom_size, interval)) {
+      failures++;
+    }
+  }
+  free(rom);
+  return failures ? 1 : 0;
+
+usage:
+  fprintf(stderr, "usage: %s [-i INTERVAL] ROM MOVIE...\n", argv[0]);
+  return 2;
+}
@@ -0,0 +1,125 @@
+// Exercise the rollback engine with a stand-in for a remote player whose
+// inputs arrive with a random delay:
+//
+//   xnes-rollback [-f FRAMES] [-d MAX_DELAY] [-s SEED] ROM
+//
+// Port 0 is local and known immediately. Port 1 is remote. Its input for
+// frame f arrives up to MAX_DELAY frames late. At the end, the state must
+// equal a straight run with every input known in time. The worst time per
+// resimulated frame is reported against the 60Hz frame budget.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "nes.h"
+#include "rollback.h"
+
+#define FRAME_BUDGET_NS 16639267
+
+static uint32_t fb[PPU_WIDTH * PPU_HEIGHT];
+
+int main(int argc, char **argv) {
+  long frames = 3600;
+  long max_delay = ROLLBACK_FRAMES - 1;
+  unsigned seed = 1;
+  int opt;
+  while ((opt = getopt(argc, argv, "f:d:s:")) != -1) {
+    switch (opt) {
+    case 'f':
+      frames = strtol(optarg, NULL, 10);
+      break;
+    case 'd':
+      max_delay = strtol(optarg, NULL, 10);
+      break;
+    case 's':
+      seed = strtoul(optarg, NULL, 10);
+      break;
+    default:
+      goto usage;
+    }
+  }
+  if (argc - optind != 1 || frames <= 0 || max_delay < 0 ||
+      ROLLBACK_FRAMES <= max_delay) {
+    goto usage;
+  }
+
+  size_t rom_size;
+  uint8_t *rom = read_file(argv[optind], &rom_size);
+  uint8_t(*inputs)[2] = malloc(frames * sizeof(*inputs));
+  long *arrival = malloc(frames * sizeof(long));
+  if (!rom || !inputs || !arrival) {
+    perror(argv[optind]);
+    return 1;
+  }
+
+  // buttons held for a few frames, as players do
+  srand(seed);
+  uint8_t held[2] = {0, 0};
+  for (long f = 0; f < frames; f++) {
+    for (int port = 0; port < 2; port++) {
+      if (rand() % 8 == 0) {
+        held[port] = rand();
+      }
+      inputs[f][port] = held[port];
+    }
+    arrival[f] = f + rand() % (max_delay + 1);
+  }
+
+  // reference run with every input in time
+  static nes reference, state;
+  nes_init(&reference);
+  if (!nes_load_rom(&reference, rom, rom_size)) {
+    fprintf(stderr, "%s: unsupported ROM\n", argv[optind]);
+    return 1;
+  }
+  nes_power_on(&reference);
+  for (long f = 0; f < frames; f++) {
+    nes_set_buttons(&reference, 0, inputs[f][0]);
+    nes_set_buttons(&reference, 1, inputs[f][1]);
+    nes_run_frame(&reference, NULL, 0);
+  }
+  nes_save_state(&reference, &state);
+  uint64_t expected = nes_state_hash(&state);
+
+  static nes n;
+  static rollback r;
+  nes_init(&n);
+  nes_load_rom(&n, rom, rom_size);
+  nes_power_on(&n);
+  rollback_init(&r, &n);
+  for (long host = 0; host < frames + max_delay; host++) {
+    for (long f = host - max_delay; f <= host; f++) {
+      if (0 <= f && f < frames && arrival[f] == host) {
+        rollback_set_input(&r, f, 1, inputs[f][1]);
+      }
+    }
+    if (host < frames) {
+      rollback_set_input(&r, host, 0, inputs[host][0]);
+      rollback_advance(&r, fb, PPU_WIDTH);
+    }
+  }
+  rollback_resimulate(&r);
+  nes_save_state(&n, &state);
+  uint64_t actual = nes_state_hash(&state);
+
+  printf("frames %ld, resimulated %ju, worst %" PRIu64
+         " ns per resimulated frame (%.1f per frame budget)\n",
+         frames, r.resimulated_frames, r.worst_resimulation_ns,
+         r.worst_resimulation_ns ? (double)FRAME_BUDGET_NS /
+                                       r.worst_resimulation_ns
+                                 : 0.0);
+  printf("state %016" PRIx64 ", expected %016" PRIx64 ": %s\n", actual,
+         expected, actual == expected ? "ok" : "MISMATCH");
+  free(rom);
+  free(inputs);
+  free(arrival);
+  return actual == expected ? 0 : 1;
+
+usage:
+  fprintf(stderr, "usage: %s [-f FRAMES] [-d MAX_DELAY] [-s SEED] ROM\n",
+          argv[0]);
+  return 2;
+}
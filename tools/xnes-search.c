@@ -0,0 +1,119 @@
+// Breadth-first search over controller inputs from power-on, printing the
+// number of distinct states per layer:
+//
+//   xnes-search [-j THREADS] [-f FRAMES] [-n MAX_NODES] [-d DEPTH] ROM
+//
+// Each layer holds one of the basic inputs (nothing, A, B, Start, Select or a
+// direction) for FRAMES frames (default 4). Output lines are
+// "DEPTH NODES NEW SECONDS". The last node is then rebuilt from its deltas and
+// its hash checked.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "nes.h"
+#include "search.h"
+
+static const uint8_t inputs[] = {
+    0,
+    CONTROLLER_A,
+    CONTROLLER_B,
+    CONTROLLER_SELECT,
+    CONTROLLER_START,
+    CONTROLLER_UP,
+    CONTROLLER_DOWN,
+    CONTROLLER_LEFT,
+    CONTROLLER_RIGHT,
+};
+
+static nes n;
+static nes state;
+
+static double seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+  search_options o = {
+      .inputs = inputs,
+      .input_count = sizeof(inputs),
+      .frames_per_input = 4,
+      .max_nodes = 1 << 16,
+      .threads = 1,
+  };
+  long depth = 8;
+  int opt;
+  while ((opt = getopt(argc, argv, "j:f:n:d:")) != -1) {
+    switch (opt) {
+    case 'j':
+      o.threads = atoi(optarg);
+      break;
+    case 'f':
+      o.frames_per_input = strtoul(optarg, NULL, 10);
+      break;
+    case 'n':
+      o.max_nodes = strtoul(optarg, NULL, 10);
+      break;
+    case 'd':
+      depth = strtol(optarg, NULL, 10);
+      break;
+    default:
+      goto usage;
+    }
+  }
+  if (argc - optind != 1 || o.threads <= 0 || o.frames_per_input == 0) {
+    goto usage;
+  }
+
+  size_t rom_size;
+  uint8_t *rom = read_file(argv[optind], &rom_size);
+  if (!rom) {
+    perror(argv[optind]);
+    return 1;
+  }
+  nes_init(&n);
+  if (!nes_load_rom(&n, rom, rom_size)) {
+    fprintf(stderr, "%s: unsupported ROM\n", argv[optind]);
+    return 1;
+  }
+  nes_power_on(&n);
+
+  search *s = search_create(&n, &o);
+  if (!s) {
+    fprintf(stderr, "cannot allocate %zu nodes\n", o.max_nodes);
+    return 1;
+  }
+  double start = seconds();
+  for (long d = 1; d <= depth; d++) {
+    size_t added = search_step(s);
+    printf("%ld %zu %zu %.3f\n", d, search_node_count(s), added,
+           seconds() - start);
+    if (added == 0) {
+      break;
+    }
+  }
+
+  size_t last = search_node_count(s) - 1;
+  const search_node *node = search_get_node(s, last);
+  search_node_state(s, last, &n);
+  nes_save_state(&n, &state);
+  bool ok = search_state_hash(&state) == node->hash;
+  printf("node %zu depth %" PRIu32 " hash %016" PRIx64 " %s\n", last,
+         node->depth, node->hash, ok ? "ok" : "mismatch");
+
+  search_destroy(s);
+  free(rom);
+  return ok ? 0 : 1;
+
+usage:
+  fprintf(stderr,
+          "usage: %s [-j THREADS] [-f FRAMES] [-n MAX_NODES] [-d DEPTH] ROM\n",
+          argv[0]);
+  return 2;
+}
@@ -0,0 +1,590 @@
+// Host a pool of machines for clients on the same host:
+//
+//   xnes-server [-n INSTANCES] [-j THREADS] SOCKET ROM
+//
+// Clients connect to the UNIX socket SOCKET and send batches of commands
+// (step, reset, snapshot save and load). Inputs, RAM and frames are exchanged
+// through one shared memory region, so only commands and replies go through
+// the socket. Commands of a batch run in parallel across instances, in order
+// for each instance, and batches from different clients one at a time.
+//
+// On connecting, a client receives the size of the region as a uint64_t along
+// with its file descriptor (SCM_RIGHTS), and maps it. The region starts with a
+// server_header, followed by a server_slot per instance at slot_offset +
+// i * slot_size. Everything is in host byte order.
+//
+// A batch is a uint32_t count followed by count server_command; the reply is
+// count server_reply. Before a step, the client writes the buttons into the
+// instance's slot. The step renders its last frame into the frame ring entry
+// after the newest one, so the previous frame can still be read meanwhile.
+// Snapshots are kept in the server, SERVER_SNAPSHOTS per instance. Instances
+// start, and reset to, one frame after power-on, which begins mid-frame, so
+// that every step renders whole frames.
+//
+// Instances are shared by all clients, which should use disjoint ones.
+//
+// The same tool is a test client stepping BATCH instances (default all from
+// FIRST on) with random inputs for STEPS batches of FRAMES frames each:
+//
+//   xnes-server -c [-o FIRST] [-b BATCH] [-s STEPS] [-k FRAMES] SOCKET [ROM]
+//
+// It prints batches, steps and frames per second. Given the ROM, it also
+// checks the RAM, the frame and a snapshot round trip of instance FIRST
+// against its own emulation.
+
+#define _GNU_SOURCE
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "nes.h"
+#include "pool.h"
+
+#define SERVER_MAGIC 0x58534E58 // "XNSX"
+#define SERVER_VERSION 1
+#define SERVER_FRAME_RING 2
+#define SERVER_SNAPSHOTS 4
+#define SERVER_MAX_BATCH 65536
+#define SERVER_PAGE 4096
+
+typedef struct ServerHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t instances;
+  uint32_t slot_offset;
+  uint32_t slot_size;
+} server_header;
+
+typedef struct ServerSlot {
+  uint8_t buttons[2]; // port 0 and 1, written by the client
+  uint32_t latest;    // frames[latest] is the newest frame
+  uint64_t frame;     // nes_frame.frame after the last command
+  uint8_t ram[0x800]; // after the last command
+  uint8_t frames[SERVER_FRAME_RING][PPU_HEIGHT * PPU_WIDTH]; // palette indexes
+} server_slot;
+
+_Static_assert(offsetof(server_slot, latest) == 4 &&
+                   offsetof(server_slot, frame) == 8 &&
+                   offsetof(server_slot, ram) == 16 &&
+                   offsetof(server_slot, frames) == 16 + 0x800,
+               "the slot layout is part of the protocol");
+
+typedef enum ServerOp {
+  SERVER_STEP,  // arg frames, the last one rendered
+  SERVER_RESET, // back to the start
+  SERVER_SAVE,  // arg snapshot
+  SERVER_LOAD,  // arg snapshot
+} server_op;
+
+typedef struct ServerCommand {
+  uint32_t op;
+  uint32_t instance;
+  uint32_t arg;
+} server_command;
+
+typedef enum ServerStatus {
+  SERVER_OK,
+  SERVER_BAD_COMMAND,
+  SERVER_NO_SNAPSHOT,
+} server_status;
+
+typedef struct ServerReply {
+  uint32_t status;
+  uint32_t latest; // as in the slot after the command
+  uint64_t frame;
+} server_reply;
+
+#define NONE UINT32_MAX
+
+typedef struct Instance {
+  nes machine;
+  nes *snapshots[SERVER_SNAPSHOTS];
+  uint32_t first, last; // commands of the batch in progress
+} instance;
+
+static struct {
+  uint8_t *shm;
+  size_t shm_size;
+  int shm_fd;
+  uint32_t slot_offset, slot_size;
+
+  nes start;
+  instance *instances;
+  uint32_t count;
+  pool *pool;
+
+  // one batch at a time, chained by instance
+  pthread_mutex_t lock;
+  const server_command *commands;
+  server_reply *replies;
+  uint32_t next[SERVER_MAX_BATCH];
+  uint32_t *touched;
+} server;
+
+static server_slot *slot_at(uint8_t *shm, const server_header *h,
+                            uint32_t i) {
+  return (server_slot *)(shm + h->slot_offset + (size_t)i * h->slot_size);
+}
+
+static bool socket_address(const char *path, struct sockaddr_un *addr) {
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  if (sizeof(addr->sun_path) <= strlen(path)) {
+    fprintf(stderr, "%s: socket path too long\n", path);
+    return false;
+  }
+  strcpy(addr->sun_path, path);
+  return true;
+}
+
+// Server
+
+static server_status execute(uint32_t i, const server_command *c) {
+  instance *in = &server.instances[i];
+  nes *n = &in->machine;
+  server_slot *s = slot_at(server.shm, (server_header *)server.shm, i);
+  switch (c->op) {
+  case SERVER_STEP: {
+    uint32_t latest = (s->latest + 1) % SERVER_FRAME_RING;
+    nes_set_buttons(n, 0, s->buttons[0]);
+    nes_set_buttons(n, 1, s->buttons[1]);
+    for (uint32_t f = 1; f <= c->arg; f++) {
+      nes_run_frame_indexed(n, f == c->arg ? s->frames[latest] : NULL,
+                            PPU_WIDTH);
+    }
+    if (c->arg) {
+      s->latest = latest;
+    }
+    break;
+  }
+  case SERVER_RESET:
+    nes_load_state(n, &server.start);
+    break;
+  case SERVER_SAVE:
+    if (SERVER_SNAPSHOTS <= c->arg) {
+      return SERVER_BAD_COMMAND;
+    }
+    if (!in->snapshots[c->arg]) {
+      in->snapshots[c->arg] = aligned_alloc(NES_CACHE_LINE, sizeof(nes));
+      if (!in->snapshots[c->arg]) {
+        return SERVER_NO_SNAPSHOT;
+      }
+    }
+    nes_save_state(n, in->snapshots[c->arg]);
+    return SERVER_OK;
+  case SERVER_LOAD:
+    if (SERVER_SNAPSHOTS <= c->arg) {
+      return SERVER_BAD_COMMAND;
+    }
+    if (!in->snapshots[c->arg]) {
+      return SERVER_NO_SNAPSHOT;
+    }
+    nes_load_state(n, in->snapshots[c->arg]);
+    break;
+  default:
+    return SERVER_BAD_COMMAND;
+  }
+  s->frame = n->ppu.frame;
+  memcpy(s->ram, n->ram, sizeof(s->ram));
+  return SERVER_OK;
+}
+
+static void run_instance(void *ctx, size_t t) {
+  (void)ctx;
+  uint32_t i = server.touched[t];
+  server_slot *s = slot_at(server.shm, (server_header *)server.shm, i);
+  for (uint32_t c = server.instances[i].first; c != NONE;
+       c = server.next[c]) {
+    server_reply *r = &server.replies[c];
+    r->status = execute(i, &server.commands[c]);
+    r->latest = s->latest;
+    r->frame = s->frame;
+  }
+}
+
+static void run_batch(const server_command *commands, server_reply *replies,
+                      uint32_t count) {
+  pthread_mutex_lock(&server.lock);
+  size_t touched = 0;
+  for (uint32_t c = 0; c < count; c++) {
+    uint32_t i = commands[c].instance;
+    replies[c] = (server_reply){SERVER_BAD_COMMAND, 0, 0};
+    if (server.count <= i) {
+      continue;
+    }
+    instance *in = &server.instances[i];
+    if (in->first == NONE) {
+      in->first = c;
+      server.touched[touched++] = i;
+    } else {
+      server.next[in->last] = c;
+    }
+    in->last = c;
+    server.next[c] = NONE;
+  }
+  server.commands = commands;
+  server.replies = replies;
+  pool_run(server.pool, touched, run_instance, NULL);
+  for (size_t t = 0; t < touched; t++) {
+    server.instances[server.touched[t]].first = NONE;
+  }
+  pthread_mutex_unlock(&server.lock);
+}
+
+static bool send_region(int fd) {
+  uint64_t size = server.shm_size;
+  struct iovec iov = {&size, sizeof(size)};
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof(int))];
+  } control;
+  memset(&control, 0, sizeof(control));
+  struct msghdr msg = {.msg_iov = &iov,
+                       .msg_iovlen = 1,
+                       .msg_control = control.buf,
+                       .msg_controllen = sizeof(control.buf)};
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &server.shm_fd, sizeof(int));
+  return sendmsg(fd, &msg, 0) == (ssize_t)sizeof(size);
+}
+
+static void *client_main(void *arg) {
+  int fd = (int)(intptr_t)arg;
+  server_command *commands = malloc(SERVER_MAX_BATCH * sizeof(server_command));
+  server_reply *replies = malloc(SERVER_MAX_BATCH * sizeof(server_reply));
+  uint32_t count;
+  if (commands && replies && send_region(fd)) {
+    while (read_full(fd, &count, sizeof(count)) && count <= SERVER_MAX_BATCH &&
+           read_full(fd, commands, count * sizeof(server_command))) {
+      run_batch(commands, replies, count);
+      if (!write_full(fd, replies, count * sizeof(server_reply))) {
+        break;
+      }
+    }
+  }
+  free(commands);
+  free(replies);
+  close(fd);
+  return NULL;
+}
+
+static bool create_region(uint32_t count) {
+  server.slot_offset = SERVER_PAGE;
+  server.slot_size =
+      (sizeof(server_slot) + SERVER_PAGE - 1) / SERVER_PAGE * SERVER_PAGE;
+  server.shm_size = server.slot_offset + (size_t)count * server.slot_size;
+  server.shm_fd = memfd_create("xnes-server", MFD_CLOEXEC);
+  if (server.shm_fd < 0 || ftruncate(server.shm_fd, server.shm_size) != 0) {
+    return false;
+  }
+  server.shm = mmap(NULL, server.shm_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    server.shm_fd, 0);
+  if (server.shm == MAP_FAILED) {
+    return false;
+  }
+  *(server_header *)server.shm = (server_header){
+      SERVER_MAGIC, SERVER_VERSION, count, server.slot_offset,
+      server.slot_size};
+  return true;
+}
+
+static int serve(const char *path, const char *rom_path, uint32_t count,
+                 int threads) {
+  size_t rom_size;
+  uint8_t *rom = read_file(rom_path, &rom_size);
+  if (!rom) {
+    perror(rom_path);
+    return 1;
+  }
+  static nes n;
+  nes_init(&n);
+  if (!nes_load_rom(&n, rom, rom_size)) {
+    fprintf(stderr, "%s: unsupported ROM\n", rom_path);
+    return 1;
+  }
+  nes_power_on(&n);
+  nes_run_frame_indexed(&n, NULL, 0);
+  nes_save_state(&n, &server.start);
+
+  server.count = count;
+  server.instances = aligned_alloc(NES_CACHE_LINE, count * sizeof(instance));
+  server.touched = calloc(count, sizeof(uint32_t));
+  server.pool = pool_create(threads);
+  if (!server.instances || !server.touched || !server.pool ||
+      !create_region(count)) {
+    perror("xnes-server");
+    return 1;
+  }
+  pthread_mutex_init(&server.lock, NULL);
+  for (uint32_t i = 0; i < count; i++) {
+    instance *in = &server.instances[i];
+    memset(in, 0, sizeof(*in));
+    nes_init(&in->machine);
+    in->machine.cartridge.prg_rom = n.cartridge.prg_rom;
+    in->machine.cartridge.chr_rom = n.cartridge.chr_rom;
+    nes_load_state(&in->machine, &server.start);
+    in->first = NONE;
+    server_slot *s = slot_at(server.shm, (server_header *)server.shm, i);
+    s->frame = n.ppu.frame;
+    memcpy(s->ram, n.ram, sizeof(s->ram));
+  }
+
+  struct sockaddr_un addr;
+  if (!socket_address(path, &addr)) {
+    return 1;
+  }
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(path);
+  if (listener < 0 || bind(listener, (struct sockaddr *)&addr, sizeof(addr)) ||
+      listen(listener, SOMAXCONN)) {
+    perror(path);
+    return 1;
+  }
+  signal(SIGPIPE, SIG_IGN); // a client going away ends its thread only
+
+  for (;;) {
+    int fd = accept(listener, NULL, NULL);
+    if (fd < 0) {
+      continue;
+    }
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, client_main, (void *)(intptr_t)fd)) {
+      close(fd);
+      continue;
+    }
+    pthread_detach(thread);
+  }
+}
+
+// Client
+
+static double seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int receive_region(int fd, uint64_t *size) {
+  struct iovec iov = {size, sizeof(*size)};
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof(int))];
+  } control;
+  struct msghdr msg = {.msg_iov = &iov,
+                       .msg_iovlen = 1,
+                       .msg_control = control.buf,
+                       .msg_controllen = sizeof(control.buf)};
+  if (recvmsg(fd, &msg, MSG_WAITALL) != (ssize_t)sizeof(*size)) {
+    return -1;
+  }
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if (!cmsg || cmsg->cmsg_level != SOL_SOCKET ||
+      cmsg->cmsg_type != SCM_RIGHTS) {
+    return -1;
+  }
+  int shm_fd;
+  memcpy(&shm_fd, CMSG_DATA(cmsg), sizeof(int));
+  return shm_fd;
+}
+
+static bool round_trip(int fd, const server_command *commands,
+                       server_reply *replies, uint32_t count) {
+  if (!write_full(fd, &count, sizeof(count)) ||
+      !write_full(fd, commands, count * sizeof(server_command)) ||
+      !read_full(fd, replies, count * sizeof(server_reply))) {
+    return false;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    if (replies[i].status != SERVER_OK) {
+      fprintf(stderr, "command %" PRIu32 ": status %" PRIu32 "\n", i,
+              replies[i].status);
+      return false;
+    }
+  }
+  return true;
+}
+
+static nes local;
+static nes local_snapshot;
+static uint8_t local_fb[PPU_WIDTH * PPU_HEIGHT];
+
+// Mirror a step of instance 0 and compare
+static bool check_step(const server_slot *s, const server_reply *r,
+                       uint32_t frames) {
+  nes_set_buttons(&local, 0, s->buttons[0]);
+  nes_set_buttons(&local, 1, s->buttons[1]);
+  for (uint32_t f = 1; f <= frames; f++) {
+    nes_run_frame_indexed(&local, f == frames ? local_fb : NULL, PPU_WIDTH);
+  }
+  return r->frame == local.ppu.frame &&
+         memcmp(s->ram, local.ram, sizeof(s->ram)) == 0 &&
+         memcmp(s->frames[r->latest], local_fb, sizeof(local_fb)) == 0;
+}
+
+static int client(const char *path, const char *rom_path, uint32_t first,
+                  uint32_t batch, long steps, uint32_t frames) {
+  uint8_t *rom = NULL;
+  if (rom_path) {
+    size_t rom_size;
+    rom = read_file(rom_path, &rom_size);
+    nes_init(&local);
+    if (!rom || !nes_load_rom(&local, rom, rom_size)) {
+      fprintf(stderr, "%s: cannot load ROM\n", rom_path);
+      return 1;
+    }
+    nes_power_on(&local);
+    nes_run_frame_indexed(&local, NULL, 0);
+  }
+
+  struct sockaddr_un addr;
+  if (!socket_address(path, &addr)) {
+    return 1;
+  }
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+    perror(path);
+    return 1;
+  }
+  uint64_t size;
+  int shm_fd = receive_region(fd, &size);
+  uint8_t *shm = shm_fd < 0 ? MAP_FAILED
+                            : mmap(NULL, size, PROT_READ | PROT_WRITE,
+                                   MAP_SHARED, shm_fd, 0);
+  if (shm == MAP_FAILED) {
+    fprintf(stderr, "%s: no shared memory from the server\n", path);
+    return 1;
+  }
+  const server_header *h = (const server_header *)shm;
+  if (h->magic != SERVER_MAGIC || h->version != SERVER_VERSION) {
+    fprintf(stderr, "%s: unknown server\n", path);
+    return 1;
+  }
+  if (h->instances <= first) {
+    fprintf(stderr, "%s: %" PRIu32 " instances\n", path, h->instances);
+    return 1;
+  }
+  if (batch == 0 || h->instances - first < batch) {
+    batch = h->instances - first;
+  }
+
+  server_command *commands = calloc(batch, sizeof(server_command));
+  server_reply *replies = calloc(batch, sizeof(server_reply));
+  if (!commands || !replies) {
+    perror("calloc");
+    return 1;
+  }
+  for (uint32_t i = 0; i < batch; i++) {
+    commands[i] = (server_command){SERVER_RESET, first + i, 0};
+  }
+  bool ok = round_trip(fd, commands, replies, batch);
+
+  uint32_t seed = 1;
+  double start = seconds();
+  for (long step = 0; ok && step < steps; step++) {
+    for (uint32_t i = 0; i < batch; i++) {
+      seed = seed * 1103515245 + 12345;
+      slot_at(shm, h, first + i)->buttons[0] = seed >> 24;
+      commands[i] = (server_command){SERVER_STEP, first + i, frames};
+    }
+    ok = round_trip(fd, commands, replies, batch);
+    if (ok && rom) {
+      ok = check_step(slot_at(shm, h, first), &replies[0], frames);
+    }
+  }
+  double elapsed = seconds() - start;
+
+  if (ok && rom) {
+    // save, step away, load back: RAM must match the state saved
+    server_command c[] = {{SERVER_SAVE, first, 1},
+                          {SERVER_STEP, first, frames},
+                          {SERVER_LOAD, first, 1}};
+    server_reply r[3];
+    nes_save_state(&local, &local_snapshot);
+    ok = round_trip(fd, c, r, 3) &&
+         memcmp(slot_at(shm, h, first)->ram, local_snapshot.ram,
+                sizeof(local_snapshot.ram)) == 0 &&
+         r[2].frame == local_snapshot.ppu.frame;
+  }
+  if (ok) {
+    printf("%.0f batches/s %.0f steps/s %.0f frames/s%s\n", steps / elapsed,
+           steps * batch / elapsed, steps * batch * frames / elapsed,
+           rom ? " ok" : "");
+  } else {
+    fprintf(stderr, "%s: %s\n", path, rom ? "mismatch" : "failed");
+  }
+  free(commands);
+  free(replies);
+  free(rom);
+  close(fd);
+  return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+  bool is_client = false;
+  uint32_t count = 16;
+  int threads = 1;
+  uint32_t first = 0;
+  uint32_t batch = 0;
+  long steps = 100;
+  uint32_t frames = 1;
+  int opt;
+  while ((opt = getopt(argc, argv, "cn:j:o:b:s:k:")) != -1) {
+    switch (opt) {
+    case 'c':
+      is_client = true;
+      break;
+    case 'n':
+      count = strtoul(optarg, NULL, 10);
+      break;
+    case 'j':
+      threads = atoi(optarg);
+      break;
+    case 'o':
+      first = strtoul(optarg, NULL, 10);
+      break;
+    case 'b':
+      batch = strtoul(optarg, NULL, 10);
+      break;
+    case 's':
+      steps = strtol(optarg, NULL, 10);
+      break;
+    case 'k':
+      frames = strtoul(optarg, NULL, 10);
+      break;
+    default:
+      goto usage;
+    }
+  }
+  int args = argc - optind;
+  if (is_client && (args == 1 || args == 2) && batch <= SERVER_MAX_BATCH &&
+      0 < steps && 0 < frames) {
+    return client(argv[optind], args == 2 ? argv[optind + 1] : NULL, first,
+                  batch, steps, frames);
+  }
+  if (!is_client && args == 2 && 0 < count && 0 < threads) {
+    return serve(argv[optind], argv[optind + 1], count, threads);
+  }
+
+usage:
+  fprintf(stderr,
+          "usage: %s [-n INSTANCES] [-j THREADS] SOCKET ROM\n"
+          "       %s -c [-o FIRST] [-b BATCH] [-s STEPS] [-k FRAMES] SOCKET "
+          "[ROM]\n",
+          argv[0], argv[0]);
+  return 2;
+}
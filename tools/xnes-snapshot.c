@@ -0,0 +1,167 @@
+// Write and load snapshot files (src/snapshot.h):
+//
+//   xnes-snapshot [-z] [-e EVERY] ROM MOVIE OUT
+//
+// replays the input movie MOVIE and writes the state after every EVERY
+// frames (default 60) into OUT, with compressed chunks with -z.
+//
+//   xnes-snapshot -l ROM SNAPSHOT
+//
+// opens SNAPSHOT and loads every state into a machine. Both print the number
+// of states, the time taken and a hash over the nes_state_hash() of all
+// states, which is the same for a file and its load.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "hash.h"
+#include "movie.h"
+#include "nes.h"
+#include "snapshot.h"
+
+static nes n;
+static nes state;
+
+static double seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t add_state(uint64_t h) {
+  nes_save_state(&n, &state);
+  uint64_t state_hash = nes_state_hash(&state);
+  return hash64(&state_hash, sizeof(state_hash), h);
+}
+
+static int write_states(const char *movie_path, const char *out_path,
+                        uint32_t every, bool compress) {
+  FILE *in = fopen(movie_path, "rb");
+  if (!in) {
+    perror(movie_path);
+    return 1;
+  }
+  movie_header h;
+  if (!movie_read_header(in, &h) ||
+      h.rom_hash != cartridge_hash(&n.cartridge)) {
+    fprintf(stderr, "%s: not a movie for this ROM\n", movie_path);
+    return 1;
+  }
+  snapshot_writer *w = snapshot_create(out_path, h.rom_hash, compress);
+  if (!w) {
+    perror(out_path);
+    return 1;
+  }
+
+  double start = seconds();
+  uint64_t states_hash = 0;
+  uint32_t states = 0;
+  movie_power_on(&n, &h);
+  for (uint32_t i = 1; i <= h.frames; i++) {
+    uint8_t buttons[2];
+    if (!movie_read_frame(in, &h, buttons)) {
+      fprintf(stderr, "%s: truncated at frame %" PRIu32 "\n", movie_path, i);
+      snapshot_finish(w);
+      return 1;
+    }
+    nes_set_buttons(&n, 0, buttons[0]);
+    nes_set_buttons(&n, 1, buttons[1]);
+    nes_run_frame(&n, NULL, 0);
+    if (i % every == 0) {
+      snapshot_add(w, &n);
+      states_hash = add_state(states_hash);
+      states++;
+    }
+  }
+  fclose(in);
+  if (!snapshot_finish(w)) {
+    fprintf(stderr, "%s: write failed\n", out_path);
+    return 1;
+  }
+  printf("%" PRIu32 " states %.3f s %016" PRIx64 "\n", states,
+         seconds() - start, states_hash);
+  return 0;
+}
+
+static int load_states(const char *path) {
+  double start = seconds();
+  snapshot *s = snapshot_open(path);
+  if (!s) {
+    fprintf(stderr, "%s: not a valid snapshot file\n", path);
+    return 1;
+  }
+  if (snapshot_rom_hash(s) != cartridge_hash(&n.cartridge)) {
+    fprintf(stderr, "%s: states of another ROM\n", path);
+    return 1;
+  }
+  double opened = seconds();
+  uint64_t states_hash = 0;
+  for (size_t i = 0; i < snapshot_count(s); i++) {
+    if (!snapshot_load(s, i, &n)) {
+      fprintf(stderr, "%s: state %zu does not load in this build\n", path, i);
+      return 1;
+    }
+    states_hash = add_state(states_hash);
+  }
+  double end = seconds();
+  printf("%zu states open %.3f ms load %.3f ms %016" PRIx64 "\n",
+         snapshot_count(s), (opened - start) * 1e3, (end - opened) * 1e3,
+         states_hash);
+  snapshot_close(s);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  bool load = false;
+  bool compress = false;
+  long every = 60;
+  int opt;
+  while ((opt = getopt(argc, argv, "lze:")) != -1) {
+    switch (opt) {
+    case 'l':
+      load = true;
+      break;
+    case 'z':
+      compress = true;
+      break;
+    case 'e':
+      every = strtol(optarg, NULL, 10);
+      break;
+    default:
+      goto usage;
+    }
+  }
+  int args = argc - optind;
+  if (every <= 0 || args != (load ? 2 : 3)) {
+    goto usage;
+  }
+
+  const char *rom_path = argv[optind];
+  size_t rom_size;
+  uint8_t *rom = read_file(rom_path, &rom_size);
+  if (!rom) {
+    perror(rom_path);
+    return 1;
+  }
+  nes_init(&n);
+  if (!nes_load_rom(&n, rom, rom_size)) {
+    fprintf(stderr, "%s: unsupported ROM\n", rom_path);
+    return 1;
+  }
+  int status = load ? load_states(argv[optind + 1])
+                    : write_states(argv[optind + 1], argv[optind + 2], every,
+                                   compress);
+  free(rom);
+  return status;
+
+usage:
+  fprintf(stderr,
+          "usage: %s [-z] [-e EVERY] ROM MOVIE OUT\n"
+          "       %s -l ROM SNAPSHOT\n",
+          argv[0], argv[0]);
+  return 2;
+}
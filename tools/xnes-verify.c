@@ -0,0 +1,286 @@
+// Verify a long input movie in parallel, segment by segment, using the state
+// checkpoints embedded in the movie:
+//
+//   xnes-verify [-j THREADS] ROM MOVIE
+//
+// Each segment starts from a checkpoint (the first one from power on), whose
+// state must match its hash, and must end exactly in the state of the next
+// checkpoint. Segments run on separate threads. The last checkpoint must be
+// at the last frame, so that the whole movie is verified.
+//
+// Checkpoints are embedded by replaying the movie once:
+//
+//   xnes-verify -w INTERVAL ROM MOVIE OUT
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "movie.h"
+#include "nes.h"
+
+static const uint8_t *rom;
+static size_t rom_size;
+
+static int write_checkpoints(const char *in_path, const char *out_path,
+                             uint32_t interval) {
+  FILE *in = fopen(in_path, "rb");
+  FILE *out = fopen(out_path, "wb");
+  if (!in || !out) {
+    perror("xnes-verify");
+    return 1;
+  }
+
+  static nes n;
+  static movie_checkpoint c;
+  movie_header h;
+  nes_init(&n);
+  nes_load_rom(&n, rom, rom_size);
+  if (!movie_read_header(in, &h) || h.rom_hash != cartridge_hash(&n.cartridge)) {
+    fprintf(stderr, "%s: not a movie for this ROM\n", in_path);
+    return 1;
+  }
+
+  movie_header out_h = h;
+  out_h.state_size = sizeof(nes);
+  out_h.checkpoints = (h.frames + interval - 1) / interval;
+  if (!movie_write_header(out, &out_h)) {
+    goto write_error;
+  }
+  for (uint32_t i = 0; i < h.frames; i++) {
+    uint8_t buttons[2];
+    if (!movie_read_frame(in, &h, buttons)) {
+      fprintf(stderr, "%s: truncated at frame %" PRIu32 "\n", in_path, i);
+      return 1;
+    }
+    if (!movie_write_frame(out, &h, buttons)) {
+      goto write_error;
+    }
+  }
+
+  movie_seek_frame(in, &h, 0);
+  movie_power_on(&n, &h);
+  for (uint32_t i = 1; i <= h.frames; i++) {
+    uint8_t buttons[2];
+    movie_read_frame(in, &h, buttons);
+    nes_set_buttons(&n, 0, buttons[0]);
+    nes_set_buttons(&n, 1, buttons[1]);
+    nes_run_frame(&n, NULL, 0);
+    if (i % interval == 0 || i == h.frames) {
+      c.frame = i;
+      nes_save_state(&n, &c.state);
+      c.state_hash = nes_state_hash(&c.state);
+      if (!movie_write_checkpoint(out, &c)) {
+        goto write_error;
+      }
+    }
+  }
+  fclose(in);
+  if (fclose(out) != 0) {
+    goto write_error;
+  }
+  return 0;
+
+write_error:
+  perror(out_path);
+  return 1;
+}
+
+typedef struct Segment {
+  // runs frames [first, last) from checkpoint start, or from power on if
+  // start is -1, and compares with checkpoint end
+  uint32_t first, last;
+  long start, end;
+  uint64_t expected;
+  uint64_t actual;
+  bool ok;
+} segment;
+
+typedef struct Verifier {
+  const char *path;
+  movie_header header;
+  segment *segments;
+  size_t count;
+  atomic_size_t next;
+} verifier;
+
+static bool run_segment(verifier *v, FILE *f, nes *n, movie_checkpoint *c,
+                        segment *s) {
+  const movie_header *h = &v->header;
+  nes_init(n);
+  nes_load_rom(n, rom, rom_size);
+  if (s->start < 0) {
+    movie_power_on(n, h);
+  } else if (movie_read_checkpoint(f, h, s->start, c) &&
+             nes_state_hash(&c->state) == c->state_hash) {
+    // the previous segment checked the hash, this checks the state
+    nes_load_state(n, &c->state);
+  } else {
+    return false;
+  }
+
+  if (!movie_seek_frame(f, h, s->first)) {
+    return false;
+  }
+  for (uint32_t i = s->first; i < s->last; i++) {
+    uint8_t buttons[2];
+    if (!movie_read_frame(f, h, buttons)) {
+      return false;
+    }
+    nes_set_buttons(n, 0, buttons[0]);
+    nes_set_buttons(n, 1, buttons[1]);
+    nes_run_frame(n, NULL, 0);
+  }
+  nes_save_state(n, &c->state);
+  s->actual = nes_state_hash(&c->state);
+  return s->actual == s->expected;
+}
+
+static void *worker_main(void *arg) {
+  verifier *v = arg;
+  FILE *f = fopen(v->path, "rb");
+  nes *n = aligned_alloc(NES_CACHE_LINE, sizeof(nes));
+  movie_checkpoint *c =
+      aligned_alloc(_Alignof(movie_checkpoint), sizeof(movie_checkpoint));
+  if (f && n && c) {
+    size_t i;
+    while ((i = atomic_fetch_add(&v->next, 1)) < v->count) {
+      v->segments[i].ok = run_segment(v, f, n, c, &v->segments[i]);
+    }
+  }
+  if (f) {
+    fclose(f);
+  }
+  free(n);
+  free(c);
+  return NULL;
+}
+
+static int verify(const char *path, long threads) {
+  verifier v = {.path = path};
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return 1;
+  }
+  static nes n;
+  nes_init(&n);
+  nes_load_rom(&n, rom, rom_size);
+  if (!movie_read_header(f, &v.header) ||
+      v.header.rom_hash != cartridge_hash(&n.cartridge)) {
+    fprintf(stderr, "%s: not a movie for this ROM\n", path);
+    return 1;
+  }
+  if (v.header.checkpoints == 0 || v.header.state_size != sizeof(nes)) {
+    fprintf(stderr, "%s: no checkpoints usable by this build\n", path);
+    return 1;
+  }
+
+  // segment i ends at checkpoint i
+  v.count = v.header.checkpoints;
+  v.segments = calloc(v.count, sizeof(segment));
+  movie_checkpoint *c =
+      aligned_alloc(_Alignof(movie_checkpoint), sizeof(movie_checkpoint));
+  uint32_t frame = 0;
+  for (size_t i = 0; i < v.count; i++) {
+    if (!movie_read_checkpoint(f, &v.header, i, c) || c->frame <= frame ||
+        v.header.frames < c->frame) {
+      fprintf(stderr, "%s: broken checkpoint %zu\n", path, i);
+      return 1;
+    }
+    v.segments[i] = (segment){.first = frame,
+                              .last = c->frame,
+                              .start = (long)i - 1,
+                              .end = i,
+                              .expected = c->state_hash};
+    frame = c->frame;
+  }
+  free(c);
+  fclose(f);
+
+  if ((long)v.count < threads) {
+    threads = v.count;
+  }
+  // the workers started take all segments between them
+  pthread_t *workers = calloc(threads, sizeof(pthread_t));
+  long started = 0;
+  while (workers && started < threads &&
+         pthread_create(&workers[started], NULL, worker_main, &v) == 0) {
+    started++;
+  }
+  for (long i = 0; i < started; i++) {
+    pthread_join(workers[i], NULL);
+  }
+  free(workers);
+  if (started == 0) {
+    fprintf(stderr, "xnes-verify: cannot start threads\n");
+    free(v.segments);
+    return 1;
+  }
+
+  int failures = 0;
+  for (size_t i = 0; i < v.count; i++) {
+    segment *s = &v.segments[i];
+    printf("%s frames %" PRIu32 "-%" PRIu32 " %016" PRIx64 " %s\n", path,
+           s->first, s->last, s->actual, s->ok ? "ok" : "MISMATCH");
+    failures += !s->ok;
+  }
+  if (frame < v.header.frames) {
+    printf("%s frames %" PRIu32 "-%" PRIu32 " not covered by checkpoints\n",
+           path, frame, v.header.frames);
+    failures++;
+  }
+  free(v.segments);
+  return failures ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+  long threads = sysconf(_SC_NPROCESSORS_ONLN);
+  long interval = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "j:w:")) != -1) {
+    switch (opt) {
+    case 'j':
+      threads = strtol(optarg, NULL, 10);
+      break;
+    case 'w':
+      interval = strtol(optarg, NULL, 10);
+      break;
+    default:
+      goto usage;
+    }
+  }
+  if (argc - optind != (interval ? 3 : 2) || threads <= 0 || interval < 0) {
+    goto usage;
+  }
+
+  uint8_t *buf = read_file(argv[optind], &rom_size);
+  if (!buf) {
+    perror(argv[optind]);
+    return 1;
+  }
+  rom = buf;
+  static nes n;
+  nes_init(&n);
+  if (!nes_load_rom(&n, rom, rom_size)) {
+    fprintf(stderr, "%s: unsupported ROM\n", argv[optind]);
+    return 1;
+  }
+
+  int status = interval ? write_checkpoints(argv[optind + 1],
+                                            argv[optind + 2], interval)
+                        : verify(argv[optind + 1], threads);
+  free(buf);
+  return status;
+
+usage:
+  fprintf(stderr,
+          "usage: %s [-j THREADS] ROM MOVIE\n"
+          "       %s -w INTERVAL ROM MOVIE OUT\n",
+          argv[0], argv[0]);
+  return 2;
+}